@@ -1,90 +1,205 @@
 #include "application.h"
+#include "triplebuffer.h"
 #include <imgui.h>
 
 #include <iostream>
 #include <math.h>
 #include <deque>
-#include <chrono>
+#include <memory>
 
 #include <add.h>
+#include <circles.h>
+#include <counters.h>
+#include <pbd.h>
+#include <traceexport.h>
 using namespace math;
 
+// workload of the scene per frame, see counters.h
+perf::Counter particlesAlive("particles/alive", perf::Counter::GAUGE);
+perf::Counter particlesSpawned("particles/spawned");
+perf::Counter particlesCulled("particles/culled");
+
 class TestApp : public Application
 {
 #define COLOR_OUT    nvgRGBA(220,50,50,255)
 #define COLOR_IN     nvgRGBA(50,50,220,255)
 #define COLOR_SOLVED nvgRGBA(50,220,50,255)
+#define KEY_SPEED    600.f // px/s
 
 public:
     TestApp(int w, int h, const char * title) : Application(title, w, h) {
+        setupStyle();
+        setupScene(w, h);
+    }
+
+    TestApp(int w, int h, const char * title, const HeadlessOptions &options) : Application(title, w, h, options) {
+        setupScene(w, h);
+    }
+
+    TestApp(int w, int h, const char * title, const OffscreenOptions &options) : Application(title, w, h, options) {
+        setupStyle();
+        setupScene(w, h);
+    }
+
+    // start the pbd demo without going through the debug menu
+    void enablePBD() {
+        simulatePBD = true;
+        pbdBounds = Vector2f(width/pixelRatio, height/pixelRatio);
+        pbdRequested = true;
+    }
 
+    void setupStyle() {
         ImGui::StyleColorsClassic();
 
         const char* name = IMGUI_FONT_FOLDER"/Cousine-Regular.ttf";
         nvgCreateFont(vg, "sans", name);
+    }
 
-        lastFrame = std::chrono::high_resolution_clock::now();
-
+    void setupScene(int w, int h) {
         Vector2f center = {w/2, 130 + (h-130)/2};
         circleKeyStart = center + Vector2f{-200, -100};
         circleMouseStart = center + Vector2f{-200,  100};
         circleKey   = {circleKeyStart,   30, COLOR_OUT, nvgRGBA(10, 10, 10, 255)};
+        circleKeyPrev = circleKeyStart;
         circleMouse = {circleMouseStart, 20, COLOR_OUT, nvgRGBA(10, 10, 10, 255)};
         rect = Box{center + Vector2f{200, 0}, Vector2f(150, 200), nvgRGBA(150, 150, 150, 250), nvgRGBA(10, 10, 10, 200)};
+        publishState();
 
     }
 
     void process() override {
-        std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-#ifdef SINGLE_BUFFER
-        if(std::chrono::duration_cast<std::chrono::microseconds>(now-lastFrame).count() >= 1./60. * 1.e6)
-#endif
-        {
-            Vector2f vel(0, 0);
-            if(keyDown[GLFW_KEY_LEFT])
-                vel[0] -= 1;
-            if(keyDown[GLFW_KEY_RIGHT])
-                vel[0] += 1;
-            if(keyDown[GLFW_KEY_UP])
-                vel[1] -= 1;
-            if(keyDown[GLFW_KEY_DOWN])
-                vel[1] += 1;
-            circleKey.pos = math::add(circleKey.pos, vel/(vel.norm()+1e-10) * 10);
-
-            bool isInsideKey = rect.isInside(circleKey.pos, circleKey.radius);
-            bool isInsideMouse = rect.isInside(circleMouse.pos, circleMouse.radius);
-            circleKey.colorFill = (isInsideKey) ? (isInsideMouse ? COLOR_SOLVED : COLOR_IN) : COLOR_OUT;
-            circleMouse.colorFill = (isInsideMouse) ? (isInsideKey ? COLOR_SOLVED : COLOR_IN) : COLOR_OUT;
-
-            if(draggingCircle)
-                circleMouse.pos = math::add(Vector2f(mouseState.lastMouseX, mouseState.lastMouseY), - draggingCircleOffset);
-
-            if(isInsideKey && isInsideMouse){
-                auto make_circle = [&](Vector2f origin)
-                {
-                    float randX = (5.f*((float) rand() / (RAND_MAX)) + .1f) * ((rand()%2) ? -1 : 1);
-                    float randY = (5.f*((float) rand() / (RAND_MAX)) + .1f) * ((rand()%2) ? -1 : 1);
-                    float randR = 30.f*((float) rand() / (RAND_MAX)) + 10.f;
-                    unsigned char r = rand() % 255;
-                    unsigned char g = rand() % 255;
-                    unsigned char b = rand() % 255;
-                    unsigned char a = rand() % 255;
-                    circles.push_back({Vector2f(randX, randY), Circle{origin, randR, nvgRGBA(r, g, b, a), nvgRGBA(r, g, b, (2*a)%255)}});
-                };
-
-                make_circle(circleKey.pos);
-                make_circle(circleMouse.pos);
-
-                if(circles.size() > 500)
-                    circles.erase(circles.begin(), circles.begin()+10);
-
-                for(auto &c : circles)
-                    c.second.pos += c.first;
-            }
-            else{
-                circles.clear();
-            }
-            lastFrame = now;
+        Vector2f vel(0, 0);
+        if(keyDown[GLFW_KEY_LEFT])
+            vel[0] -= 1;
+        if(keyDown[GLFW_KEY_RIGHT])
+            vel[0] += 1;
+        if(keyDown[GLFW_KEY_UP])
+            vel[1] -= 1;
+        if(keyDown[GLFW_KEY_DOWN])
+            vel[1] += 1;
+        circleKeyPrev = circleKey.pos;
+        circleKey.pos = math::add(circleKey.pos, vel/(vel.norm()+1e-10) * KEY_SPEED * timeStep);
+
+        bool isInsideKey = rect.isInside(circleKey.pos, circleKey.radius);
+        bool isInsideMouse = rect.isInside(circleMouse.pos, circleMouse.radius);
+        circleKey.colorFill = (isInsideKey) ? (isInsideMouse ? COLOR_SOLVED : COLOR_IN) : COLOR_OUT;
+        circleMouse.colorFill = (isInsideMouse) ? (isInsideKey ? COLOR_SOLVED : COLOR_IN) : COLOR_OUT;
+
+        if(draggingCircle)
+            circleMouse.pos = math::add(Vector2f(mouseState.lastMouseX, mouseState.lastMouseY), - draggingCircleOffset);
+
+        if(isInsideKey && isInsideMouse){
+            PROFILE_ZONE("particles");
+            // velocities in px/s
+            auto make_circle = [&](Vector2f origin)
+            {
+                float randX = 60.f * (5.f*((float) rand() / (RAND_MAX)) + .1f) * ((rand()%2) ? -1 : 1);
+                float randY = 60.f * (5.f*((float) rand() / (RAND_MAX)) + .1f) * ((rand()%2) ? -1 : 1);
+                float randR = 30.f*((float) rand() / (RAND_MAX)) + 10.f;
+                unsigned char r = rand() % 255;
+                unsigned char g = rand() % 255;
+                unsigned char b = rand() % 255;
+                unsigned char a = rand() % 255;
+                circles.push_back({Vector2f(randX, randY), Circle{origin, randR, nvgRGBA(r, g, b, a), nvgRGBA(r, g, b, (2*a)%255)}});
+            };
+
+            make_circle(circleKey.pos);
+            make_circle(circleMouse.pos);
+            particlesSpawned.add(2);
+
+            if(circles.size() > 500)
+                circles.erase(circles.begin(), circles.begin()+10);
+
+            moveCircles(circles, timeStep);
+        }
+        else{
+            circles.clear();
+        }
+
+        if(pbdRequested != pbdRunning){
+            pbdRunning = pbdRequested;
+            if(pbdRunning)
+                resetPBD();
+            else
+                pbd.clear();
+        }
+        if(pbdRunning){
+            PROFILE_ZONE("pbd");
+            pbd.step(timeStep);
+        }
+
+        particlesAlive.set((int64_t)(circles.size() + pbd.particles.size()));
+
+        // anything still moving needs another frame
+        moving = vel.squaredNorm() > 0 || draggingCircle || !circles.empty() || pbdRunning;
+    }
+
+    bool isDirty() override {
+        return moving;
+    }
+
+    // hand the state drawNanoVG() needs over to the render thread
+    void publishState() override {
+        Scene &scene = scenes.writeBuffer();
+        scene.key = circleKey;
+        scene.keyPrev = circleKeyPrev;
+        scene.mouse = circleMouse;
+        scene.circles.assign(circles.begin(), circles.end());
+        scene.particles = pbd.particles;
+        scene.cursor = Vector2f(mouseState.lastMouseX, mouseState.lastMouseY);
+        scenes.publish();
+    }
+
+    void acquireState() override {
+        scenes.update();
+    }
+
+    // collect what is on screen
+    void cull() override {
+        PROFILE_ZONE("cull");
+        const Scene &scene = scenes.readBuffer();
+        float w = width/pixelRatio, h = height/pixelRatio;
+        auto visible = [w, h](const Vector2f &p, float r){
+            return p[0] + r >= 0 && p[0] - r <= w && p[1] + r >= 0 && p[1] - r <= h;
+        };
+
+        visibleCircles.clear();
+        if(drawCircles)
+            for(int i = 0; i < (int)scene.circles.size(); ++i)
+                // pad by one step for the interpolation in buildDrawLists()
+                if(visible(scene.circles[i].second.pos, scene.circles[i].second.radius + scene.circles[i].first.norm() * timeStep))
+                    visibleCircles.push_back(i);
+
+        visibleParticles.clear();
+        if(simulatePBD)
+            for(int i = 0; i < (int)scene.particles.size(); ++i)
+                if(visible(scene.particles[i].pos, scene.particles[i].radius))
+                    visibleParticles.push_back(i);
+
+        if(drawCircles)
+            particlesCulled.add((int64_t)(scene.circles.size() - visibleCircles.size()));
+        if(simulatePBD)
+            particlesCulled.add((int64_t)(scene.particles.size() - visibleParticles.size()));
+    }
+
+    // turn the visible circles into the list drawNanoVG() submits
+    void buildDrawLists() override {
+        PROFILE_ZONE("build draw lists");
+        const Scene &scene = scenes.readBuffer();
+        drawList.clear();
+
+        // interpolate between the last two simulation steps
+        for(int i : visibleCircles){
+            const auto &c = scene.circles[i];
+            Circle circle = c.second;
+            circle.pos -= c.first * timeStep * (1.f - interpolationAlpha);
+            drawList.push_back({circle, 4.f});
+        }
+
+        for(int i : visibleParticles){
+            const Particle &p = scene.particles[i];
+            NVGcolor fill = (p.invMass == 0.f) ? rect.colorStroke : nvgRGBA(50, 50, 220, 200);
+            drawList.push_back({Circle{p.pos, p.radius, fill, rect.colorStroke}, 2.f});
         }
     }
 
@@ -104,6 +219,10 @@ public:
         if(BeginMenu("debug")){
             Checkbox("draw cursor", &drawCursor);
             Checkbox("draw circles", &drawCircles);
+            if(Checkbox("pbd demo", &simulatePBD)){
+                pbdBounds = Vector2f(width/pixelRatio, height/pixelRatio);
+                pbdRequested = simulatePBD;
+            }
             ImGui::EndMenu();
         }
         Text("| window size: %d x %d", width, height);
@@ -112,6 +231,7 @@ public:
     }
 
     void drawNanoVG() override {
+        const Scene &scene = scenes.readBuffer();
 
         // draw Box
         nvgBeginPath(vg);
@@ -122,6 +242,16 @@ public:
         nvgStrokeWidth(vg, 4.0f);
         nvgStroke(vg);
 
+        for(const auto &d : drawList){
+            nvgBeginPath(vg);
+            nvgCircle(vg, d.circle.pos[0], d.circle.pos[1], d.circle.radius);
+            nvgFillColor(vg, d.circle.colorFill);
+            nvgFill(vg);
+            nvgStrokeColor(vg, d.circle.colorStroke);
+            nvgStrokeWidth(vg, d.strokeWidth);
+            nvgStroke(vg);
+        }
+
         if(drawCircles)
         {
             auto drawCircle = [this](const Circle &circle){
@@ -134,33 +264,33 @@ public:
                 nvgStroke(vg);
             };
 
-            for(const auto &c : circles)
-                drawCircle(c.second);
-
             // draw circle key
-            drawCircle(circleKey);
+            Circle key = scene.key;
+            key.pos = scene.keyPrev + (scene.key.pos - scene.keyPrev) * interpolationAlpha;
+            drawCircle(key);
             {
                 nvgBeginPath(vg);
                 nvgFontFace(vg, "sans");
                 nvgFontSize(vg, 16.f);
-                float d = (circleKey.pos - circleKeyStart).squaredNorm();
+                float d = (key.pos - circleKeyStart).squaredNorm();
                 nvgFillColor(vg, nvgRGBAf(0, 0, 0, std::max(0.f, 1.f-0.0001f*d)));
                 nvgFontBlur(vg, std::min(1000.f, d));
                 nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
-                nvgText(vg, circleKey.pos[0] + circleKey.radius + 5, circleKey.pos[1], "move me with arrow keys", nullptr);
+                nvgText(vg, key.pos[0] + key.radius + 5, key.pos[1], "move me with arrow keys", nullptr);
                 nvgFill(vg);
             }
 
-            drawCircle(circleMouse);
+            const Circle &mouse = scene.mouse;
+            drawCircle(mouse);
             {
                 nvgBeginPath(vg);
                 nvgFontFace(vg, "sans");
                 nvgFontSize(vg, 16.f);
-                float d = (circleMouse.pos - circleMouseStart).squaredNorm();
+                float d = (mouse.pos - circleMouseStart).squaredNorm();
                 nvgFillColor(vg, nvgRGBAf(0, 0, 0, std::max(0.f, 1.f-0.0001f*d)));
                 nvgFontBlur(vg, std::min(1000.f, 0.3f*d));
                 nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
-                nvgText(vg, circleMouse.pos[0] + circleMouse.radius + 5, circleMouse.pos[1], "drag me with the cursor", nullptr);
+                nvgText(vg, mouse.pos[0] + mouse.radius + 5, mouse.pos[1], "drag me with the cursor", nullptr);
                 nvgFill(vg);
             }
         }
@@ -168,7 +298,7 @@ public:
         if(drawCursor){
             nvgBeginPath(vg);
             nvgFillColor(vg, rect.colorStroke);
-            nvgCircle(vg, mouseState.lastMouseX, mouseState.lastMouseY, 10.f);
+            nvgCircle(vg, scene.cursor[0], scene.cursor[1], 10.f);
             nvgFill(vg);
         }
     }
@@ -187,6 +317,17 @@ protected:
     }
 
 private:
+    // a rope, a chain and a soft body falling onto a pile of loose circles
+    void resetPBD() {
+        pbd.clear();
+        pbd.setBounds(Vector2f(0, 0), pbdBounds);
+        pbd.addRope(Vector2f(60, 80), Vector2f(360, 80), 30, 5.f, 0.f, 1e-1f);
+        pbd.addRope(Vector2f(pbdBounds[0] - 60, 80), Vector2f(pbdBounds[0] - 260, 80), 12, 8.f, 0.f, 1e-4f);
+        pbd.addSoftBody(Vector2f(pbdBounds[0]/2 - 40, 60), 6, 6, 16.f, 7.f, 1e-5f);
+        for (int i = 0; i < 100; ++i)
+            pbd.addParticle(Vector2f(40 + (i%25) * 24, pbdBounds[1] - 200 + (i/25) * 24), 10.f);
+    }
+
     int loadFonts(NVGcontext* vg)
     {
         int font;
@@ -206,17 +347,17 @@ private:
 private:
     bool drawCursor = false;
     bool drawCircles = true;
+    bool simulatePBD = false;
+    // the simulation thread picks up changes of pbdRequested, and of the
+    // bounds set before it, in process()
+    std::atomic<bool> pbdRequested{false};
+    Vector2f pbdBounds;
+    bool pbdRunning = false;
+    PBDSolver pbd;
+    bool moving = true;
     Vector2f circleKeyStart, circleMouseStart;
-    struct Circle
-    {
-        Vector2f pos;
-        float radius;
-        NVGcolor colorFill, colorStroke;
-
-        bool isInside(const Vector2f &x){
-            return (x-pos).squaredNorm() <= radius*radius;
-        }
-    } circleKey, circleMouse;
+    typedef math::Circle<NVGcolor> Circle;
+    Circle circleKey, circleMouse;
     struct Box {
         bool isInside(const Vector2f &x, float slack = 0.f) {
             for (int i = 0; i < 2; ++i)
@@ -233,13 +374,116 @@ private:
     bool draggingCircle = false;
     Vector2f draggingCircleOffset;
     std::deque<std::pair<Vector2f, Circle>> circles;
-    std::chrono::high_resolution_clock::time_point lastFrame;
+    Vector2f circleKeyPrev;
+
+    struct Scene {
+        Circle key, mouse;
+        Vector2f keyPrev;
+        std::vector<std::pair<Vector2f, Circle>> circles;
+        std::vector<Particle> particles;
+        Vector2f cursor;
+    };
+    TripleBuffer<Scene> scenes;
+
+    struct DrawCircle {
+        Circle circle;
+        float strokeWidth;
+    };
+    std::vector<int> visibleCircles, visibleParticles;
+    std::vector<DrawCircle> drawList;
 };
 
-int main(int, char**)
+// usage: app [--sim-thread | --pipelined] [--pbd]
+//        app --headless [--steps N] [--seconds S] [--pbd]
+//        app --offscreen [--frames N] [--seconds S] [--output frame%04d.png] [--pbd]
+//        app --on-demand [--pbd]
+// any mode also takes --record file or --replay file [--max-speed], and
+// --trace file.json to stream profiler zones to a Chrome trace and
+// --hw-counters to sample hardware counters per zone
+int main(int argc, char** argv)
 {
-    TestApp app(720, 560, "Assignment 0");
-    app.run();
+    bool headless = false, offscreen = false, simThread = false, pipelined = false, pbd = false;
+    HeadlessOptions options;
+    OffscreenOptions offscreenOptions;
+    long steps = -1;
+    std::string recordPath, replayPath, tracePath;
+    bool maxSpeed = false, onDemand = false, hwCounters = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+            headless = true;
+        else if (arg == "--steps" && i + 1 < argc)
+            steps = std::atol(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            options.seconds = std::atof(argv[++i]);
+        else if (arg == "--offscreen")
+            offscreen = true;
+        else if (arg == "--frames" && i + 1 < argc)
+            offscreenOptions.frames = std::atol(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            offscreenOptions.outputPattern = argv[++i];
+        else if (arg == "--sim-thread")
+            simThread = true;
+        else if (arg == "--pipelined")
+            pipelined = true;
+        else if (arg == "--pbd")
+            pbd = true;
+        else if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--max-speed")
+            maxSpeed = true;
+        else if (arg == "--on-demand")
+            onDemand = true;
+        else if (arg == "--trace" && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (arg == "--hw-counters")
+            hwCounters = true;
+    }
+    // a time limit alone replaces the default step limit
+    if (steps >= 0 || options.seconds > 0)
+        options.steps = std::max(steps, 0L);
+    // a replay alone runs to its end
+    else if (!replayPath.empty())
+        options.steps = 0;
+
+    offscreenOptions.seconds = options.seconds;
+
+    std::unique_ptr<TestApp> app;
+    if (headless)
+        app.reset(new TestApp(720, 560, "Assignment 0", options));
+    else if (offscreen)
+        app.reset(new TestApp(720, 560, "Assignment 0", offscreenOptions));
+    else
+        app.reset(new TestApp(720, 560, "Assignment 0"));
+    app->simulationThread = simThread;
+    app->pipelinedFrames = pipelined;
+    app->renderOnDemand = onDemand;
+    if (pbd)
+        app->enablePBD();
+    if (!replayPath.empty() && !app->startReplay(replayPath, maxSpeed)) {
+        std::cout << "Failed to read recording " << replayPath << std::endl;
+        return 1;
+    }
+    if (!recordPath.empty() && !app->startRecording(recordPath)) {
+        std::cout << "Failed to write recording " << recordPath << std::endl;
+        return 1;
+    }
+    perf::Profiler::instance().hwCounters = hwCounters;
+    std::unique_ptr<perf::TraceWriter> trace;
+    if (!tracePath.empty()) {
+        trace.reset(new perf::TraceWriter(tracePath));
+        if (!trace->isOpen()) {
+            std::cout << "Failed to write trace " << tracePath << std::endl;
+            return 1;
+        }
+    }
+    app->run();
+    if (trace) {
+        trace.reset();
+        std::cout << "trace written to " << tracePath << std::endl;
+    }
 
     return 0;
 }
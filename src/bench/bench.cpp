@@ -0,0 +1,28 @@
+#include "bench.h"
+
+#include <numeric>
+
+namespace bench {
+
+void summarize(std::vector<double> &values, Result &result) {
+    result.samples = (int)values.size();
+    if (values.empty())
+        return;
+    auto median = [](std::vector<double> &v) {
+        size_t mid = v.size() / 2;
+        std::nth_element(v.begin(), v.begin() + mid, v.end());
+        double m = v[mid];
+        if (v.size() % 2 == 0)
+            m = (m + *std::max_element(v.begin(), v.begin() + mid)) / 2;
+        return m;
+    };
+
+    result.min = *std::min_element(values.begin(), values.end());
+    result.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    result.median = median(values);
+    for (double &v : values)
+        v = std::abs(v - result.median);
+    result.mad = median(values);
+}
+
+} // namespace bench
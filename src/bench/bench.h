@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// A minimal microbenchmark harness. A benchmark sets up its data and hands
+// the kernel to State::run(), which warms it up, picks an iteration count so
+// that a sample takes sampleTime, and then times samples batches of that
+// many calls. Results are per call in nanoseconds, summarized by the median
+// and the median absolute deviation, which ignore the odd preempted sample.
+
+namespace bench {
+
+// Keeps the compiler from discarding a value that is computed but unused.
+template <typename T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+// Makes the compiler assume all memory was read and written, so stores of
+// the kernel are not optimized away.
+inline void clobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+struct Options {
+    double warmupTime = 0.05; // seconds
+    double sampleTime = 0.01;
+    int samples = 15;
+};
+
+struct Result {
+    std::string name;
+    long iterations = 0; // per sample
+    int samples = 0;
+    double median = 0, mad = 0, min = 0, mean = 0; // ns per call
+    double itemsPerCall = 1;
+    // with repeated runs of the suite: median is the median of their
+    // medians, best the lowest and runMad their MAD
+    int runs = 1;
+    double best = 0, runMad = 0;
+};
+
+// median and median absolute deviation, sorts values
+void summarize(std::vector<double> &values, Result &result);
+
+class State {
+public:
+    State(const Options &options, Result &result) : options(options), result(result) {}
+
+    // calls the kernel is made of, e.g. particles updated; reported as
+    // throughput
+    void setItems(double itemsPerCall) { result.itemsPerCall = itemsPerCall; }
+
+    // times kernel(), see above
+    template <typename F>
+    void run(F kernel) {
+        using clock = std::chrono::steady_clock;
+        auto batch = [&](long n) {
+            auto t0 = clock::now();
+            for (long i = 0; i < n; ++i) {
+                kernel();
+                clobberMemory();
+            }
+            return std::chrono::duration<double>(clock::now() - t0).count();
+        };
+
+        // warm up caches, branch predictors and clock speed while doubling
+        // the batch until it fills a sample
+        long n = 1;
+        double warm = 0;
+        while (true) {
+            double t = batch(n);
+            warm += t;
+            if (t >= options.sampleTime && warm >= options.warmupTime)
+                break;
+            if (t < options.sampleTime)
+                n = (t > 0) ? std::max(n + 1, std::min(n * 10, (long)(n * options.sampleTime / t * 1.2))) : n * 10;
+        }
+
+        std::vector<double> perCall(options.samples);
+        for (int s = 0; s < options.samples; ++s)
+            perCall[s] = batch(n) * 1e9 / n;
+        result.iterations = n;
+        summarize(perCall, result);
+    }
+
+private:
+    const Options &options;
+    Result &result;
+};
+
+struct Benchmark {
+    const char *name;
+    void (*fn)(State &state);
+};
+
+// all benchmarks of the suite, see kernels.cpp
+const std::vector<Benchmark> &benchmarks();
+
+} // namespace bench
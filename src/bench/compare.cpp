@@ -0,0 +1,120 @@
+#include "compare.h"
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+namespace bench {
+
+namespace {
+
+// MAD to standard deviation for normally distributed noise
+const double MAD_TO_SIGMA = 1.4826;
+// standard error of the median relative to that of the mean
+const double MEDIAN_EFFICIENCY = 1.2533;
+
+double standardError(const Result &r) {
+    return MEDIAN_EFFICIENCY * MAD_TO_SIGMA * r.mad / std::sqrt((double)std::max(r.samples, 1));
+}
+
+// the statistic kernels are compared by
+double best(const Result &r) {
+    return (r.best > 0) ? r.best : r.median;
+}
+
+const char *verdictName(Comparison::Verdict v) {
+    static const char *names[] = {"ok", "SLOWER", "faster", "new", "removed", "unstable"};
+    return names[v];
+}
+
+} // namespace
+
+std::vector<Comparison> compare(const std::vector<Result> &baseline, const std::vector<Result> &current,
+                                const CompareOptions &options, double *speedFactor) {
+    std::map<std::string, const Result *> base;
+    for (const auto &r : baseline)
+        base[r.name] = &r;
+
+    // how much faster or slower this machine runs the suite
+    double factor = 1;
+    if (options.normalize) {
+        std::vector<double> ratios;
+        for (const auto &r : current) {
+            auto it = base.find(r.name);
+            if (it != base.end() && best(*it->second) > 0)
+                ratios.push_back(best(r) / best(*it->second));
+        }
+        if (!ratios.empty()) {
+            Result summary;
+            summarize(ratios, summary);
+            factor = summary.median;
+        }
+    }
+    if (speedFactor)
+        *speedFactor = factor;
+
+    std::vector<Comparison> comparisons;
+    for (const auto &r : current) {
+        Comparison c;
+        c.name = r.name;
+        c.current = best(r);
+        auto it = base.find(r.name);
+        if (it == base.end()) {
+            c.verdict = Comparison::ADDED;
+            comparisons.push_back(c);
+            continue;
+        }
+        const Result &b = *it->second;
+        c.baseline = best(b) * factor;
+        c.ratio = (c.baseline > 0) ? c.current / c.baseline : 1;
+
+        double runToRun = MAD_TO_SIGMA * b.runMad * factor;
+        double seBase = standardError(b) * factor, seCurrent = standardError(r);
+        double sigma = std::sqrt(runToRun * runToRun + seBase * seBase + seCurrent * seCurrent);
+        sigma = std::max(sigma, options.minNoise * c.baseline);
+        c.z = (sigma > 0) ? (c.current - c.baseline) / sigma : 0;
+        if (c.z > options.zThreshold)
+            c.verdict = Comparison::SLOWER;
+        else if (c.z < -options.zThreshold)
+            c.verdict = Comparison::FASTER;
+        comparisons.push_back(c);
+    }
+
+    for (const auto &r : baseline) {
+        bool found = false;
+        for (const auto &c : current)
+            found |= c.name == r.name;
+        if (!found) {
+            Comparison c;
+            c.name = r.name;
+            c.baseline = best(r) * factor;
+            c.verdict = Comparison::REMOVED;
+            comparisons.push_back(c);
+        }
+    }
+    return comparisons;
+}
+
+int printReport(const std::vector<Comparison> &comparisons, double speedFactor) {
+    std::printf("%-30s %14s %14s %8s %8s  %s\n", "benchmark", "baseline ns", "current ns", "ratio", "z", "verdict");
+    int regressions = 0, improvements = 0;
+    for (const auto &c : comparisons) {
+        std::printf("%-30s %14.1f %14.1f %7.3fx %8.2f  %s\n", c.name.c_str(), c.baseline, c.current, c.ratio, c.z,
+                    verdictName(c.verdict));
+        regressions += c.verdict == Comparison::SLOWER;
+        improvements += c.verdict == Comparison::FASTER;
+    }
+    std::printf("\nbaseline scaled by %.3f, the median ratio of all kernels\n", speedFactor);
+    if (improvements)
+        std::printf("%d kernel(s) got faster, consider updating the baseline\n", improvements);
+    if (regressions) {
+        std::printf("%d kernel(s) got slower:", regressions);
+        for (const auto &c : comparisons)
+            if (c.verdict == Comparison::SLOWER)
+                std::printf(" %s (%.1f%%)", c.name.c_str(), (c.ratio - 1) * 100);
+        std::printf("\n");
+    }
+    return regressions;
+}
+
+} // namespace bench
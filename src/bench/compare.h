@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+// Compares repeated runs of the suite to a baseline measured the same way.
+// Kernels are compared by their best run (lowest median): other load on the
+// machine only ever adds time, and comes and goes over seconds, so the best
+// of runs spread over time is the steadiest estimate. The difference is
+// measured in standard deviations of the noise, not in percent: the
+// baseline's run-to-run spread of medians plus the standard errors of both
+// medians (estimated from their MADs), at least minNoise.
+//
+// By default the median ratio over all kernels is divided out first, so a
+// uniformly slower or faster machine passes and only kernels that changed
+// relative to the rest stand out; the baseline's run-to-run spread is
+// measured the same way. A change that slows down every kernel alike is not
+// caught.
+
+namespace bench {
+
+struct CompareOptions {
+    double zThreshold = 4.0;
+    // a floor for the noise, relative to the baseline median, so very steady
+    // kernels do not fail on differences too small to matter
+    double minNoise = 0.04;
+    bool normalize = true;
+};
+
+struct Comparison {
+    // UNSTABLE: slower, but not in every attempt (see main.cpp)
+    enum Verdict { SAME, SLOWER, FASTER, ADDED, REMOVED, UNSTABLE };
+
+    std::string name;
+    double baseline = 0, current = 0; // best ns per call, baseline scaled
+    double ratio = 1, z = 0;
+    Verdict verdict = SAME;
+};
+
+std::vector<Comparison> compare(const std::vector<Result> &baseline, const std::vector<Result> &current,
+                                const CompareOptions &options, double *speedFactor = nullptr);
+
+// prints a line per kernel; returns the number of regressions
+int printReport(const std::vector<Comparison> &comparisons, double speedFactor);
+
+} // namespace bench
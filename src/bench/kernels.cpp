@@ -0,0 +1,314 @@
+#include "bench.h"
+
+#include <cmath>
+#include <random>
+
+#include <add.h>
+#include <circles.h>
+#include <colormap.h>
+#include <framestats.h>
+#include <parallel.h>
+#include <pbd.h>
+#include <taskgraph.h>
+
+using namespace math;
+
+// Kernels of the hot paths: math, the PBD solver, the particle update of the
+// test app, a frame run serially and as a task graph, colormap lookups and the
+// decimation and statistics behind the frame-time plots. Names are "group/kernel"; keep them stable, they key the
+// baseline.
+
+namespace {
+
+std::vector<Vector2f> randomPoints(int n, float scale, unsigned int seed = 1) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(0.f, scale);
+    std::vector<Vector2f> points(n);
+    for (auto &p : points)
+        p = Vector2f(dist(rng), dist(rng));
+    return points;
+}
+
+void mathAdd(bench::State &state) {
+    const int n = 1024;
+    std::vector<Vector2f> a = randomPoints(n, 1.f, 1), b = randomPoints(n, 1.f, 2), out(n);
+    state.setItems(n);
+    state.run([&]() {
+        for (int i = 0; i < n; ++i)
+            out[i] = math::add(a[i], b[i]);
+        bench::doNotOptimize(out.data());
+    });
+}
+
+void parallelForInline(bench::State &state) {
+    ThreadPool pool(1);
+    std::vector<float> values(4096, 1.f);
+    state.setItems((double)values.size());
+    state.run([&]() {
+        pool.parallelFor((int)values.size(), 256, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+                values[i] *= 1.0001f;
+        });
+        bench::doNotOptimize(values.data());
+    });
+}
+
+// the scenes of the sweep runner, stepped single threaded
+void pbdStepRope(bench::State &state) {
+    PBDSolver pbd(1);
+    pbd.setBounds(Vector2f(0, 0), Vector2f(800, 600));
+    pbd.addRope(Vector2f(100, 50), Vector2f(700, 50), 40, 8.f);
+    // settle into the steady state first
+    for (int i = 0; i < 60; ++i)
+        pbd.step(1.f / 60.f);
+    state.setItems(pbd.particles.size());
+    state.run([&]() { pbd.step(1.f / 60.f); });
+}
+
+void pbdStepSoftBody(bench::State &state) {
+    PBDSolver pbd(1);
+    pbd.setBounds(Vector2f(0, 0), Vector2f(800, 600));
+    pbd.addSoftBody(Vector2f(200, 50), 10, 6, 20.f, 8.f);
+    for (int i = 0; i < 60; ++i)
+        pbd.step(1.f / 60.f);
+    state.setItems(pbd.particles.size());
+    state.run([&]() { pbd.step(1.f / 60.f); });
+}
+
+void pbdStepParticles(bench::State &state) {
+    PBDSolver pbd(1);
+    pbd.setBounds(Vector2f(0, 0), Vector2f(800, 600));
+    pbd.addParticleRows(Vector2f(0, 0), 800, 400, 6.f);
+    for (int i = 0; i < 60; ++i)
+        pbd.step(1.f / 60.f);
+    state.setItems(pbd.particles.size());
+    state.run([&]() { pbd.step(1.f / 60.f); });
+}
+
+void pbdColorConstraints(bench::State &state) {
+    // a 32 x 32 lattice of distance constraints
+    const int cols = 32, rows = 32;
+    std::vector<Constraint> constraints;
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            Constraint c;
+            c.p[0] = y * cols + x;
+            if (x + 1 < cols) {
+                c.p[1] = c.p[0] + 1;
+                constraints.push_back(c);
+            }
+            if (y + 1 < rows) {
+                c.p[1] = c.p[0] + cols;
+                constraints.push_back(c);
+            }
+        }
+    }
+    ConstraintBatches batches;
+    ColoringBuffers buffers;
+    state.setItems(constraints.size());
+    state.run([&]() {
+        colorConstraints(constraints, cols * rows, batches, buffers);
+        bench::doNotOptimize(batches.constraints.data());
+    });
+}
+
+// the circles of the test app: velocity next to position and colors
+void particlesIntegrate(bench::State &state) {
+    // the size of NVGcolor, which needs the GUI
+    struct Color {
+        float rgba[4];
+    };
+    std::vector<Vector2f> vel = randomPoints(500, 300.f);
+    std::vector<std::pair<Vector2f, Circle<Color>>> circles(vel.size());
+    for (size_t i = 0; i < vel.size(); ++i)
+        circles[i] = {vel[i], Circle<Color>{Vector2f::Zero(), 1.f, {}, {}}};
+    state.setItems(circles.size());
+    state.run([&]() {
+        moveCircles(circles, 1.f / 60.f);
+        bench::doNotOptimize(circles.data());
+    });
+}
+
+// A frame shaped like the test app's with --pipelined: the last simulation
+// state is published, then the next step is simulated while the published
+// particles are culled, turned into a draw list and submitted (on the
+// calling thread, as with OpenGL). Run serially or through Application's
+// task graph to compare the two.
+struct Frame {
+    PBDSolver pbd{1};
+    std::vector<Particle> settled, published;
+    std::vector<int> visible;
+    std::vector<Circle<float>> drawList;
+    float submitted = 0.f;
+
+    Frame() {
+        pbd.setBounds(Vector2f(0, 0), Vector2f(800, 600));
+        pbd.addRope(Vector2f(100, 50), Vector2f(700, 50), 40, 8.f);
+        pbd.addSoftBody(Vector2f(200, 150), 10, 6, 20.f, 8.f);
+        pbd.addParticleRows(Vector2f(0, 300), 800, 200, 6.f);
+        for (int i = 0; i < 60; ++i)
+            pbd.step(1.f / 60.f);
+        settled = pbd.particles;
+    }
+
+    // every frame starts from the same state, so that all do the same work
+    void publish() {
+        pbd.particles = settled;
+        published = settled;
+    }
+
+    void simulate() { pbd.step(1.f / 60.f); }
+
+    // the viewport is the left half of the scene
+    void cull() {
+        visible.clear();
+        for (int i = 0; i < (int)published.size(); ++i) {
+            const Particle &p = published[i];
+            if (p.pos[0] + p.radius >= 0 && p.pos[0] - p.radius <= 400 && p.pos[1] + p.radius >= 0 &&
+                p.pos[1] - p.radius <= 600)
+                visible.push_back(i);
+        }
+    }
+
+    void buildDrawList() {
+        drawList.clear();
+        for (int i : visible) {
+            const Particle &p = published[i];
+            drawList.push_back({p.pos, p.radius, p.invMass == 0.f ? 1.f : 0.5f, 0.f});
+        }
+    }
+
+    void submit() {
+        for (const auto &c : drawList) {
+            float r, g, b;
+            colorMapColor(c.colorFill, r, g, b);
+            submitted += c.pos[0] * r + c.pos[1] * g + c.radius * b;
+        }
+    }
+};
+
+void frameSerial(bench::State &state) {
+    Frame frame;
+    state.setItems(frame.pbd.particles.size());
+    state.run([&]() {
+        frame.publish();
+        frame.simulate();
+        frame.cull();
+        frame.buildDrawList();
+        frame.submit();
+        bench::doNotOptimize(frame.submitted);
+    });
+}
+
+void framePipelined(bench::State &state) {
+    Frame frame;
+    TaskGraph graph;
+    TaskScheduler scheduler;
+    auto simulate = graph.add("simulate", [&]() { frame.simulate(); });
+    auto cull = graph.add("cull", [&]() { frame.cull(); });
+    auto build = graph.add("build draw lists", [&]() { frame.buildDrawList(); });
+    auto submit = graph.add("submit", [&]() { frame.submit(); }, true);
+    graph.precede(cull, build);
+    graph.precede(build, submit);
+    (void)simulate;
+
+    state.setItems(frame.pbd.particles.size());
+    state.run([&]() {
+        frame.publish();
+        graph.run(scheduler);
+        bench::doNotOptimize(frame.submitted);
+    });
+}
+
+void colormapLookup(bench::State &state) {
+    const int n = 4096;
+    std::vector<double> x(n);
+    for (int i = 0; i < n; ++i)
+        x[i] = std::fmod(i * 0.618034, 1.0);
+    state.setItems(n);
+    state.run([&]() {
+        float sum = 0.f;
+        for (int i = 0; i < n; ++i) {
+            float r, g, b;
+            colorMapColor(x[i], r, g, b);
+            sum += r + g + b;
+        }
+        bench::doNotOptimize(sum);
+    });
+}
+
+void decimate(bench::State &state, int n, int buckets) {
+    std::vector<float> values(n), lo(buckets), hi(buckets);
+    std::mt19937 rng(3);
+    std::exponential_distribution<float> dist(1.f / 16.f);
+    for (auto &v : values)
+        v = dist(rng);
+    state.setItems(n);
+    state.run([&]() {
+        perf::decimateMinMax(values.data(), n, buckets, lo.data(), hi.data());
+        bench::doNotOptimize(hi.data());
+    });
+}
+
+// the frame stats plot: a 600 frame window to 200 columns
+void decimateWindow(bench::State &state) {
+    decimate(state, 600, 200);
+}
+
+void decimateLong(bench::State &state) {
+    decimate(state, 100000, 1000);
+}
+
+void histogramAddRemove(bench::State &state) {
+    perf::LogHistogram histogram;
+    std::vector<double> values(1024);
+    std::mt19937 rng(4);
+    std::lognormal_distribution<double> dist(2.8, 0.3);
+    for (auto &v : values)
+        v = dist(rng);
+    for (double v : values)
+        histogram.add(v);
+    state.setItems(values.size());
+    state.run([&]() {
+        for (double v : values) {
+            histogram.remove(v);
+            histogram.add(v);
+        }
+        bench::doNotOptimize(histogram.count());
+    });
+}
+
+void histogramQuantile(bench::State &state) {
+    perf::LogHistogram histogram;
+    std::mt19937 rng(5);
+    std::lognormal_distribution<double> dist(2.8, 0.3);
+    for (int i = 0; i < 600; ++i)
+        histogram.add(dist(rng));
+    state.run([&]() { bench::doNotOptimize(histogram.quantile(0.99)); });
+}
+
+} // namespace
+
+namespace bench {
+
+const std::vector<Benchmark> &benchmarks() {
+    static const std::vector<Benchmark> all = {
+        {"math/add", mathAdd},
+        {"math/parallel-for-inline", parallelForInline},
+        {"pbd/step-rope", pbdStepRope},
+        {"pbd/step-softbody", pbdStepSoftBody},
+        {"pbd/step-particles", pbdStepParticles},
+        {"pbd/color-constraints", pbdColorConstraints},
+        {"particles/integrate", particlesIntegrate},
+        {"frame/serial", frameSerial},
+        {"frame/pipelined", framePipelined},
+        {"colormap/lookup", colormapLookup},
+        {"plot/decimate-window", decimateWindow},
+        {"plot/decimate-long", decimateLong},
+        {"stats/histogram-add-remove", histogramAddRemove},
+        {"stats/histogram-quantile", histogramQuantile},
+    };
+    return all;
+}
+
+} // namespace bench
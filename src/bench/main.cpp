@@ -0,0 +1,264 @@
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "bench.h"
+#include "compare.h"
+
+using nlohmann::json;
+
+// Runs the benchmarks of kernels.cpp and prints the time per call; with
+// --json the results are also written to a file, e.g. to archive them per
+// commit. --runs repeats the suite and records the best run and how much the
+// medians vary from run to run, which is what a baseline needs:
+//
+//   bench [--filter substring] [--json results.json] [--label name] [--runs N]
+//         [--samples N] [--sample-time seconds] [--warmup seconds]
+//
+// With --compare the run is checked against a baseline instead (see
+// compare.h) and the exit code is 1 if any kernel got slower, or 77 if the
+// baseline was measured with another build type:
+//
+//   bench --compare baseline.json --runs 5 --samples 5 [--z 4] [--absolute]
+//
+// To update the checked-in baseline after an intended change, run in a
+// Release build (the default)
+//
+//   bench --runs 10 --samples 5 --json ../src/bench/baseline.json
+
+namespace {
+
+// ctest counts this as skipped, see SKIP_RETURN_CODE
+const int SKIPPED = 77;
+// runs of the suite before --compare reports a regression
+const int MAX_ATTEMPTS = 3;
+
+json toJson(const bench::Result &r) {
+    return {{"name", r.name},       {"iterations", r.iterations}, {"samples", r.samples},
+            {"median_ns", r.median}, {"mad_ns", r.mad},            {"min_ns", r.min},
+            {"mean_ns", r.mean},     {"items_per_call", r.itemsPerCall},
+            {"runs", r.runs},        {"best_ns", r.best},          {"run_mad_ns", r.runMad}};
+}
+
+bench::Result fromJson(const json &j) {
+    bench::Result r;
+    r.name = j.at("name").get<std::string>();
+    r.iterations = j.value("iterations", 0L);
+    r.samples = j.value("samples", 0);
+    r.median = j.at("median_ns").get<double>();
+    r.mad = j.value("mad_ns", 0.0);
+    r.min = j.value("min_ns", 0.0);
+    r.mean = j.value("mean_ns", 0.0);
+    r.itemsPerCall = j.value("items_per_call", 1.0);
+    r.runs = j.value("runs", 1);
+    r.best = j.value("best_ns", 0.0);
+    r.runMad = j.value("run_mad_ns", 0.0);
+    return r;
+}
+
+json context(const std::string &label) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    json c = {{"date", date}, {"build_type", CMM_BUILD_TYPE}};
+#ifdef __VERSION__
+    c["compiler"] = __VERSION__;
+#endif
+    if (!label.empty())
+        c["label"] = label;
+    return c;
+}
+
+bench::Result run(const bench::Benchmark &b, const bench::Options &options) {
+    bench::Result result;
+    result.name = b.name;
+    bench::State state(options, result);
+    b.fn(state);
+    return result;
+}
+
+// Folds the results of repeated runs into one per benchmark. The run-to-run
+// spread is taken after dividing out how fast the machine ran each run as a
+// whole (the median ratio of its kernels to their medians over all runs),
+// as the comparison does, so it only holds how much a kernel varies
+// relative to the others.
+std::vector<bench::Result> combine(const std::vector<std::vector<bench::Result>> &all) {
+    std::vector<bench::Result> combined;
+    for (const auto &runs : all) {
+        bench::Result r = runs.front();
+        r.best = r.median;
+        std::vector<double> medians, mads;
+        for (const auto &run : runs) {
+            medians.push_back(run.median);
+            mads.push_back(run.mad);
+            r.min = std::min(r.min, run.min);
+            r.best = std::min(r.best, run.median);
+        }
+        bench::Result spread, noise;
+        bench::summarize(medians, spread);
+        bench::summarize(mads, noise);
+        r.median = spread.median;
+        r.mad = noise.median;
+        r.mean = spread.mean;
+        r.runs = (int)runs.size();
+        combined.push_back(r);
+    }
+
+    const size_t numRuns = all.empty() ? 0 : all.front().size();
+    std::vector<double> speed(numRuns, 1.0);
+    for (size_t run = 0; run < numRuns; ++run) {
+        std::vector<double> ratios;
+        for (size_t i = 0; i < all.size(); ++i)
+            if (combined[i].median > 0)
+                ratios.push_back(all[i][run].median / combined[i].median);
+        bench::Result summary;
+        bench::summarize(ratios, summary);
+        speed[run] = (summary.median > 0) ? summary.median : 1.0;
+    }
+    for (size_t i = 0; i < all.size(); ++i) {
+        std::vector<double> normalized;
+        for (size_t run = 0; run < numRuns; ++run)
+            normalized.push_back(all[i][run].median / speed[run]);
+        bench::Result spread;
+        bench::summarize(normalized, spread);
+        combined[i].runMad = spread.mad;
+    }
+    return combined;
+}
+
+void printResult(const bench::Result &r) {
+    std::printf("%-30s %12.1f %10.2f %12.1f %12.2f\n", r.name.c_str(), r.median,
+                (r.median > 0) ? 100 * r.mad / r.median : 0., r.min, r.median / r.itemsPerCall);
+    std::fflush(stdout);
+}
+
+// the results of every run of every benchmark; runs interleave, so slow
+// periods of the machine spread over all kernels
+std::vector<std::vector<bench::Result>> runSuite(const std::vector<const bench::Benchmark *> &selected,
+                                                 const bench::Options &options, int runs) {
+    std::vector<std::vector<bench::Result>> all(selected.size());
+    for (int r = 0; r < runs; ++r) {
+        if (runs > 1)
+            std::printf("run %d of %d\n", r + 1, runs);
+        std::printf("%-30s %12s %10s %12s %12s\n", "benchmark", "median ns", "mad %", "min ns", "ns/item");
+        for (size_t i = 0; i < selected.size(); ++i) {
+            all[i].push_back(run(*selected[i], options));
+            printResult(all[i].back());
+        }
+    }
+    return all;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bench::Options options;
+    bench::CompareOptions compareOptions;
+    std::string filter, jsonPath, label, baselinePath;
+    int runs = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (arg == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (arg == "--label" && i + 1 < argc)
+            label = argv[++i];
+        else if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--samples" && i + 1 < argc)
+            options.samples = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--sample-time" && i + 1 < argc)
+            options.sampleTime = std::atof(argv[++i]);
+        else if (arg == "--warmup" && i + 1 < argc)
+            options.warmupTime = std::atof(argv[++i]);
+        else if (arg == "--compare" && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (arg == "--z" && i + 1 < argc)
+            compareOptions.zThreshold = std::atof(argv[++i]);
+        else if (arg == "--absolute")
+            compareOptions.normalize = false;
+        else {
+            std::cout << "unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::string buildType = CMM_BUILD_TYPE;
+    if (buildType != "Release" && buildType != "RelWithDebInfo")
+        std::cout << "warning: not an optimized build (CMAKE_BUILD_TYPE=" << buildType << ")" << std::endl;
+
+    std::vector<bench::Result> baseline;
+    if (!baselinePath.empty()) {
+        std::ifstream file(baselinePath);
+        if (!file) {
+            std::cout << "Failed to read " << baselinePath << std::endl;
+            return 1;
+        }
+        json j = json::parse(file);
+        // timings of differently optimized code do not compare, not even
+        // relative to each other
+        std::string baselineType = j["context"].value("build_type", "");
+        if (baselineType != buildType) {
+            std::cout << "skipped: the baseline is of a build with CMAKE_BUILD_TYPE=" << baselineType << std::endl;
+            return SKIPPED;
+        }
+        for (const auto &b : j.at("benchmarks"))
+            baseline.push_back(fromJson(b));
+    }
+
+    std::vector<const bench::Benchmark *> selected;
+    for (const bench::Benchmark &b : bench::benchmarks())
+        if (filter.empty() || std::string(b.name).find(filter) != std::string::npos)
+            selected.push_back(&b);
+
+    std::vector<std::vector<bench::Result>> all = runSuite(selected, options, runs);
+    std::vector<bench::Result> results = combine(all);
+
+    if (!jsonPath.empty()) {
+        json out = {{"context", context(label)}, {"benchmarks", json::array()}};
+        for (const auto &r : results)
+            out["benchmarks"].push_back(toJson(r));
+        std::ofstream file(jsonPath);
+        if (!file) {
+            std::cout << "Failed to write " << jsonPath << std::endl;
+            return 1;
+        }
+        file << out.dump(2) << std::endl;
+    }
+
+    if (baselinePath.empty())
+        return 0;
+
+    // A slow period of the machine can still hit one kernel in all runs,
+    // so while any kernel looks slower all runs are repeated; a kernel only
+    // counts as slower if it did every time.
+    double speedFactor = 1;
+    std::vector<bench::Comparison> comparisons = bench::compare(baseline, results, compareOptions, &speedFactor);
+    for (int attempt = 1; attempt < MAX_ATTEMPTS; ++attempt) {
+        std::vector<std::string> suspects;
+        for (const auto &c : comparisons)
+            if (c.verdict == bench::Comparison::SLOWER)
+                suspects.push_back(c.name);
+        if (suspects.empty())
+            break;
+        std::printf("\n%d kernel(s) look slower, running again (%d of %d)\n", (int)suspects.size(), attempt + 1,
+                    MAX_ATTEMPTS);
+        results = combine(runSuite(selected, options, runs));
+        comparisons = bench::compare(baseline, results, compareOptions, &speedFactor);
+        for (auto &c : comparisons)
+            if (c.verdict == bench::Comparison::SLOWER &&
+                std::find(suspects.begin(), suspects.end(), c.name) == suspects.end())
+                c.verdict = bench::Comparison::UNSTABLE;
+    }
+
+    std::printf("\n");
+    return (bench::printReport(comparisons, speedFactor) > 0) ? 1 : 0;
+}
@@ -1,8 +1,19 @@
 #include "application.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
 #include <imgui.h>
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "glcounters.h"
+#include "glext.h"
+#include "inputrecorder.h"
+#include "offscreen.h"
+#include "shader.h"
+#include "taskgraph.h"
 
 #define NANOVG_GL3_IMPLEMENTATION
 #include <nanovg.h>
@@ -18,6 +29,15 @@
 #define RETINA_SCREEN
 #endif
 
+namespace {
+
+// workload of the drawing, see counters.h
+perf::Counter nanovgPaths("nanovg/paths");
+perf::Counter imguiVertices("imgui/vertices");
+perf::Counter imguiIndices("imgui/indices");
+
+} // namespace
+
 float get_pixel_ratio() {
 #ifdef RETINA_SCREEN
     return 2.f;
@@ -65,6 +85,8 @@ Application::Application(const char *title, int w, int h, std::string iconPath,
     }
     glfwMakeContextCurrent(window);
     glfwSwapInterval(true);
+    if (const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor()))
+        framePacer.refreshRate = mode->refreshRate;
 
     // app icon
     if(iconPath != ""){
@@ -79,7 +101,31 @@ Application::Application(const char *title, int w, int h, std::string iconPath,
     {
         throw std::runtime_error("Failed to initialize GLAD");
     }
+    loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+
+    initRendering(font);
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+
+    setCallbacks();
+}
+
+Application::Application(const char *title, int w, int h, const HeadlessOptions &options)
+    : width(w), height(h), headless(true), headlessOptions(options) {
+}
+
+Application::Application(const char *title, int w, int h, const OffscreenOptions &options)
+    : width(w), height(h), offscreen(true), offscreenOptions(options) {
+    offscreenContext.reset(new OffscreenContext(width, height));
+    initRendering(IMGUI_FONT_FOLDER"/Cousine-Regular.ttf");
+}
+
+Application::~Application()
+{
+
+}
 
+// ImGui and NanoVG on the current OpenGL context
+void Application::initRendering(const std::string &font) {
     // Setup Dear ImGui binding
     const char* glsl_version = "#version 150";
     IMGUI_CHECKVERSION();
@@ -97,17 +143,10 @@ Application::Application(const char *title, int w, int h, std::string iconPath,
     style.ScaleAllSizes(pixelRatio);
 #endif
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 
     vg = nvgCreateGL3(NVG_ANTIALIAS);
-
-    setCallbacks();
-}
-
-Application::~Application()
-{
-
+    countGLDrawCalls();
 }
 
 void Application::setCallbacks() {
@@ -118,123 +157,552 @@ void Application::setCallbacks() {
         std::cout << "Error " << error << ": " << description << std::endl;
     });
 
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* window){
+        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
+    });
+
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height){
         auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
         app->resizeWindow(width, height);
     });
 
     glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int scancode, int action, int mods){
+        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
         if(ImGui::GetIO().WantCaptureKeyboard || ImGui::GetIO().WantTextInput){
             ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
             return;
         }
 
-        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
-        app->keyDown[key] = (action != GLFW_RELEASE);
-
-        if(action == GLFW_PRESS)
-            app->keyPressed(key, mods);
-
-        if(action == GLFW_RELEASE)
-            app->keyReleased(key, mods);
-
+        InputEvent e;
+        e.time = glfwGetTime();
+        e.type = InputEvent::KEY;
+        e.button = key;
+        e.action = action;
+        e.mods = mods;
+        app->postEvent(e);
     });
 
     glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int button, int action, int mods){
+        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
         if(ImGui::GetIO().WantCaptureMouse){
             ImGui_ImplGlfw_MouseButtonCallback(window, button, action, mods);
             return;
         }
 
-        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
-
         double xpos, ypos;
         glfwGetCursorPos(window, &xpos, &ypos);
 #ifndef RETINA_SCREEN
         xpos /= app->pixelRatio;
         ypos /= app->pixelRatio;
 #endif
-        app->mouseState.onMouseClick(xpos, ypos, button, action, mods);
-
-        if(action == GLFW_PRESS)
-            app->mouseButtonPressed(button, mods);
-
-        if(action == GLFW_RELEASE)
-            app->mouseButtonReleased(button, mods);
+        InputEvent e;
+        e.time = glfwGetTime();
+        e.type = InputEvent::MOUSE_BUTTON;
+        e.button = button;
+        e.action = action;
+        e.mods = mods;
+        e.x = xpos;
+        e.y = ypos;
+        app->postEvent(e);
     });
 
     glfwSetCursorPosCallback(window, [](GLFWwindow* window, double xpos, double ypos){
+        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
         if(ImGui::GetIO().WantSetMousePos){
             return;
         }
 
-        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
 #ifndef RETINA_SCREEN
         xpos /= app->pixelRatio;
         ypos /= app->pixelRatio;
 #endif
-        app->mouseState.onMouseMove(xpos, ypos);
-
-        app->mouseMove(xpos, ypos);
+        InputEvent e;
+        e.time = glfwGetTime();
+        e.type = InputEvent::CURSOR;
+        e.x = xpos;
+        e.y = ypos;
+        app->postEvent(e);
     });
 
     glfwSetScrollCallback(window, [](GLFWwindow *window, double xoffset, double yoffset){
+        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
         if(ImGui::GetIO().WantCaptureMouse){
             ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
             return;
         }
 
-        auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
-        app->scrollWheel( xoffset, yoffset);
+        InputEvent e;
+        e.time = glfwGetTime();
+        e.type = InputEvent::SCROLL;
+        e.x = xoffset;
+        e.y = yoffset;
+        app->postEvent(e);
     });
 
     glfwSetDropCallback(window, [](GLFWwindow* window, int count, const char** filenames){
         auto app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+        app->redrawRequested = true;
         app->drop(count, filenames);
     });
 }
 
+void Application::postEvent(const InputEvent &e) {
+    // a replay provides all input
+    if (replay)
+        return;
+    if (simRunning) {
+        // the simulation drains the queue every step, so it is only full
+        // for a moment
+        while (!simEvents.push(e))
+            std::this_thread::yield();
+    } else {
+        dispatchEvent(e);
+    }
+}
+
+void Application::dispatchEvent(const InputEvent &e) {
+    if (recorder)
+        recorder->event(e, std::chrono::duration<float>(std::chrono::steady_clock::now() - recordStart).count());
+
+    switch (e.type) {
+    case InputEvent::KEY:
+        keyDown.set(e.button, e.action != GLFW_RELEASE);
+        if(e.action == GLFW_PRESS)
+            keyPressed(e.button, e.mods);
+        if(e.action == GLFW_RELEASE)
+            keyReleased(e.button, e.mods);
+        break;
+    case InputEvent::MOUSE_BUTTON:
+        mouseState.onMouseClick(e.x, e.y, e.button, e.action, e.mods);
+        if(e.action == GLFW_PRESS)
+            mouseButtonPressed(e.button, e.mods);
+        if(e.action == GLFW_RELEASE)
+            mouseButtonReleased(e.button, e.mods);
+        break;
+    case InputEvent::CURSOR:
+        mouseState.onMouseMove(e.x, e.y);
+        mouseMove(e.x, e.y);
+        break;
+    case InputEvent::SCROLL:
+        scrollWheel(e.x, e.y);
+        break;
+    }
+}
+
 void Application::run() {
-    while (!glfwWindowShouldClose(window))
-    {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    perf::setThreadName("main");
 
-        process();
+    if (headless) {
+        runHeadless();
+        return;
+    }
+
+    // shaders are built before run(), e.g. by the constructors; a warm start
+    // loads them from the binary cache
+    const Shader::BuildStats &shaders = Shader::buildStats;
+    if (shaders.compiled + shaders.cached > 0)
+        std::cout << "shaders: " << shaders.compiled << " compiled in " << shaders.compiledTime << " ms, "
+                  << shaders.cached << " from the binary cache in " << shaders.cachedTime << " ms" << std::endl;
+
+    if (offscreen) {
+        runOffscreen();
+        return;
+    }
+
+    if (replay && (simulationThread || pipelinedFrames || renderOnDemand)) {
+        std::cout << "Replaying every frame on the render thread, ignoring the simulation thread, pipelined frames and render on demand" << std::endl;
+        simulationThread = pipelinedFrames = renderOnDemand = false;
+    }
+
+    if (simulationThread) {
+        interpolationAlpha = 1.f;
+        simRunning = true;
+        simThread = std::thread([this]() { simulationLoop(); });
+    }
+
+    if (pipelinedFrames && !simulationThread) {
+        runPipelined();
+    } else {
+        while (!glfwWindowShouldClose(window))
+        {
+            markFrame();
+
+            if (!replay)
+                updateDeltaTime();
+            else if (!replayFrame())
+                break;
+
+            if (!simulationThread) {
+                PROFILE_ZONE("advance");
+                advance(deltaTime);
+                interpolationAlpha = stepAlpha;
+            }
+
+            {
+                PROFILE_ZONE("prepare");
+                acquireState();
+                cull();
+                buildDrawLists();
+            }
+            draw();
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            swapBuffers();
+            PROFILE_ZONE("wait");
+            framePacer.waitForFrame();
+            waitEvents();
+        }
+    }
+
+    if (simThread.joinable()) {
+        simRunning = false;
+        simThread.join();
+    }
+
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    glfwTerminate();
+}
 
+void Application::runPipelined() {
+    // the scheduler's workers are joined before the graph they run goes away
+    TaskGraph frame;
+    TaskScheduler scheduler;
+
+    auto input = frame.add("input", [this]() {
+        framePacer.waitForFrame();
+        waitEvents();
+        updateDeltaTime();
+    }, true);
+    auto simulate = frame.add("simulate", [this]() { advance(deltaTime); });
+    auto culling = frame.add("cull", [this]() { cull(); });
+    auto build = frame.add("build draw lists", [this]() { buildDrawLists(); });
+    auto submit = frame.add("submit", [this]() {
         draw();
+        swapBuffers();
+    }, true);
+
+    frame.precede(input, simulate);
+    frame.precede(input, culling);
+    frame.precede(culling, build);
+    frame.precede(build, submit);
+
+    while (!glfwWindowShouldClose(window)) {
+        // draw what the previous iteration simulated while this one
+        // simulates the next frame
+        markFrame();
+        interpolationAlpha = stepAlpha;
+        acquireState();
+        frame.run(scheduler);
+    }
+}
+
+void Application::runHeadless() {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const long maxSteps = headlessOptions.steps;
+    const double maxSeconds = headlessOptions.seconds;
+
+    deltaTime = timeStep;
+    interpolationAlpha = 1.f;
+
+    long steps = 0;
+    double elapsed = 0;
+    while ((maxSteps <= 0 || steps < maxSteps) && (maxSeconds <= 0 || elapsed < maxSeconds)) {
+        markFrame();
+        if (replay && !replayFrame())
+            break;
+        steps += advance(deltaTime);
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    std::cout << "headless: " << steps << " steps in " << elapsed << " s ("
+              << steps / std::max(elapsed, 1e-9) << " steps/s, "
+              << steps * timeStep << " s simulated)" << std::endl;
+}
+
+void Application::runOffscreen() {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const long maxFrames = offscreenOptions.frames;
+    const double maxSeconds = offscreenOptions.seconds;
+
+    // one simulation step per frame, so runs are reproducible
+    deltaTime = timeStep;
+
+    long frames = 0;
+    double elapsed = 0;
+    while ((maxFrames <= 0 || frames < maxFrames) && (maxSeconds <= 0 || elapsed < maxSeconds)) {
+        markFrame();
+        if (replay && !replayFrame())
+            break;
+        advance(deltaTime);
+        interpolationAlpha = stepAlpha;
+
+        acquireState();
+        cull();
+        buildDrawLists();
+        draw();
+
+        if (!offscreenOptions.outputPattern.empty()) {
+            char filename[1024];
+            snprintf(filename, sizeof(filename), offscreenOptions.outputPattern.c_str(), (int)frames);
+            if (!screenshot(filename))
+                std::cout << "Failed to write " << filename << std::endl;
+        }
+        // count rendered frames, not queued ones
+        glFinish();
+
+        frames++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    std::cout << "offscreen: " << frames << " frames in " << elapsed << " s ("
+              << frames / std::max(elapsed, 1e-9) << " fps) on "
+              << glGetString(GL_RENDERER) << std::endl;
+}
+
+void Application::updateDeltaTime() {
+    float currentFrame = glfwGetTime();
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+}
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+void Application::swapBuffers() {
+    PROFILE_ZONE("swap");
+    applySwapInterval();
 #ifdef SINGLE_BUFFER
-        glFlush();
+    glFlush();
 #else
-        glfwSwapBuffers(window);
+    glfwSwapBuffers(window);
 #endif
+    framePacer.framePresented();
+}
+
+// polls input or, rendering on demand, blocks until a frame is needed
+void Application::waitEvents() {
+    // idling would reset the accumulator and lose recorded time
+    if (!renderOnDemand || replay) {
         glfwPollEvents();
+        return;
     }
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    glfwTerminate();
+    bool idled = false;
+    while (!glfwWindowShouldClose(window)) {
+        if (redrawRequested.exchange(false)) {
+            // ImGui needs a couple of frames to settle hover and focus
+            settleFrames = 2;
+            break;
+        }
+        if (settleFrames > 0) {
+            settleFrames--;
+            break;
+        }
+        double deadline = redrawDeadline;
+        double timeout = deadline - glfwGetTime();
+        if (timeout <= 0) {
+            redrawDeadline.compare_exchange_strong(deadline, HUGE_VAL);
+            break;
+        }
+        glfwWaitEventsTimeout(std::min(timeout, 1.0));
+        idled = true;
+    }
+
+    // do not catch up with the time spent idle, just run the next step
+    if (idled) {
+        lastFrame = glfwGetTime() - timeStep;
+        accumulator = 0.f;
+    }
+}
+
+void Application::markFrame() {
+    perf::Profiler::instance().frameMark();
+    perf::Counters::instance().frameMark(perf::Profiler::instance().frameCount() - 1);
+    frameStats.frameFinished((float)perf::ticksToMs(processTicks.exchange(0)), (float)perf::ticksToMs(drawTicks));
+    drawTicks = 0;
+    perf::AllocCounters total = perf::totalAllocations();
+    frameAllocations = total - allocationsAtFrame;
+    allocationsAtFrame = total;
+}
+
+void Application::requestRedraw() {
+    redrawRequested = true;
+    if (window)
+        glfwPostEmptyEvent();
+}
+
+void Application::requestRedrawIn(double seconds) {
+    // headless runs every step and never initializes GLFW's timer
+    if (headless)
+        return;
+    double t = glfwGetTime() + seconds;
+    double deadline = redrawDeadline;
+    while (t < deadline && !redrawDeadline.compare_exchange_weak(deadline, t)) {
+    }
+    if (window)
+        glfwPostEmptyEvent();
+}
+
+// a frame limiter only works with vsync off
+void Application::applySwapInterval() {
+    bool wanted = !(framePacer.targetRate > 0);
+    if (wanted != vsync) {
+        glfwSwapInterval(wanted);
+        vsync = wanted;
+    }
 }
 
 void Application::process() {
 
 }
 
+int Application::advance(float dt) {
+    if (recorder)
+        recorder->frame(dt);
+
+    accumulator += dt;
+    int steps = 0;
+    while (accumulator >= timeStep && steps < maxStepsPerFrame) {
+        PROFILE_ZONE("process");
+        uint64_t start = perf::ticks();
+        process();
+        publishState();
+        processTicks += perf::ticks() - start;
+        accumulator -= timeStep;
+        steps++;
+    }
+    // we could not keep up: drop the backlog instead of spiraling
+    if (accumulator >= timeStep)
+        accumulator = std::fmod(accumulator, timeStep);
+    stepAlpha = accumulator / timeStep;
+    if (renderOnDemand && isDirty())
+        redrawRequested = true;
+    return steps;
+}
+
+bool Application::startRecording(const std::string &path) {
+    recorder.reset(new InputRecorder());
+    if (!recorder->open(path, timeStep)) {
+        recorder.reset();
+        return false;
+    }
+    recordStart = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool Application::startReplay(const std::string &path, bool maxSpeed) {
+    replay.reset(new InputReplay());
+    if (!replay->open(path)) {
+        replay.reset();
+        return false;
+    }
+    // the same step size makes advance() take the same steps
+    timeStep = replay->timeStep();
+    replayMaxSpeed = maxSpeed;
+    replayTime = 0;
+    return true;
+}
+
+// dispatches the events of the next recorded frame and sets deltaTime to
+// its frame time; false once the recording is over
+bool Application::replayFrame() {
+    using clock = std::chrono::steady_clock;
+    if (replay->numFrames() == 0)
+        replayStart = clock::now();
+
+    float dt;
+    if (!replay->nextFrame([this](const InputEvent &e) { dispatchEvent(e); }, dt)) {
+        std::cout << "replay: done after " << replay->numFrames() << " frames" << std::endl;
+        return false;
+    }
+    deltaTime = dt;
+
+    if (!replayMaxSpeed) {
+        replayTime += dt;
+        std::this_thread::sleep_until(replayStart + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(replayTime)));
+    }
+    return true;
+}
+
+void Application::simulationLoop() {
+    using clock = std::chrono::steady_clock;
+    perf::setThreadName("simulation");
+    auto next = clock::now();
+    while (simRunning) {
+        // dispatch in order, but leave the release of a key pressed in the
+        // same batch for the next step, so process() sees even short taps
+        KeyState pressed;
+        InputEvent e;
+        while (!simEvents.empty()) {
+            e = simEvents.front();
+            if (e.type == InputEvent::KEY && e.action == GLFW_RELEASE && pressed[e.button])
+                break;
+            if (e.type == InputEvent::KEY && e.action == GLFW_PRESS)
+                pressed.set(e.button, true);
+            simEvents.pop();
+            dispatchEvent(e);
+        }
+
+        // replays as one step per frame
+        if (recorder)
+            recorder->frame(timeStep);
+
+        {
+            PROFILE_ZONE("process");
+            uint64_t start = perf::ticks();
+            process();
+            publishState();
+            processTicks += perf::ticks() - start;
+        }
+        if (renderOnDemand && isDirty())
+            requestRedraw();
+
+        // same catch-up policy as advance(): never run more than
+        // maxStepsPerFrame steps behind real time
+        auto step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(timeStep));
+        next += step;
+        auto now = clock::now();
+        if (now - next > step * maxStepsPerFrame)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+
 void Application::draw() {
-    glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    PROFILE_ZONE("draw");
+    const uint64_t start = perf::ticks();
+    gpuTimer.beginFrame();
+    {
+        GpuTimer::Scope gpu(gpuTimer, "clear");
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
 
     // nano vg
     {
+        PROFILE_ZONE("drawNanoVG");
+        GpuTimer::Scope gpu(gpuTimer, "nanovg");
         nvgBeginFrame(vg, width/pixelRatio, height/pixelRatio, pixelRatio);
         drawNanoVG();
+        // paths queued this frame, nvgEndFrame() submits and resets them
+        nanovgPaths.add(((GLNVGcontext *)nvgInternalParams(vg)->userPtr)->npaths);
         nvgEndFrame(vg);
     }
 
+    PROFILE_ZONE("drawImGui");
     ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (window) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2((float)width, (float)height);
+        io.DeltaTime = (deltaTime > 0.f) ? deltaTime : timeStep;
+    }
 
 
     // ImGui
@@ -252,16 +720,68 @@ void Application::draw() {
             LabelText("fps", "fps: %.1f", (imguiFps) ? ImGui::GetIO().Framerate : fps);
             SameLine();
             Checkbox("imgui fps", &imguiFps);
+            Checkbox("profiler", &showProfiler);
+            SameLine();
+            Checkbox("frame stats", &showFrameStats);
+            SameLine();
+            Checkbox("allocations", &showAllocations);
+            SameLine();
+            Checkbox("counters", &showCounters);
+            // the simulation reads these concurrently to drawing
+            if (simulationThread || pipelinedFrames) {
+                LabelText("time step", "%.4f", timeStep);
+            } else {
+                InputFloat("time step", &timeStep, 0.f, 0.f, "%.4f");
+                timeStep = std::max(timeStep, 1e-4f);
+                InputInt("max steps per frame", &maxStepsPerFrame);
+                maxStepsPerFrame = std::max(maxStepsPerFrame, 1);
+            }
+            const char *uploads[] = {"per list", "orphan", "persistent"};
+            int upload = ImGui_ImplOpenGL3_GetUpload();
+            if (Combo("imgui uploads", &upload, uploads, IM_ARRAYSIZE(uploads)))
+                ImGui_ImplOpenGL3_SetUpload((ImGui_ImplOpenGL3_Upload)upload);
+            Checkbox("imgui shadow gl state", &imguiShadowState);
+            if (window) {
+                Separator();
+                Checkbox("render on demand", &renderOnDemand);
+                float targetRate = (float)framePacer.targetRate;
+                if (InputFloat("target fps (0: vsync)", &targetRate, 0.f, 0.f, "%.1f")) {
+                    framePacer.targetRate = std::max(targetRate, 0.f);
+                    framePacer.resetStats();
+                }
+                bool lowLatency = framePacer.mode == FramePacer::LOW_LATENCY;
+                if (Checkbox("low latency", &lowLatency))
+                    framePacer.mode = lowLatency ? FramePacer::LOW_LATENCY : FramePacer::THROUGHPUT;
+                const PacingStats &stats = framePacer.stats();
+                Text("pacing error: mean %.2f ms, jitter %.2f ms, max %.2f ms",
+                     stats.meanError * 1e3, stats.jitter * 1e3, stats.maxError * 1e3);
+                Text("missed: %d of %d, work %.2f ms", stats.missed, FramePacer::WINDOW, stats.workTime * 1e3);
+            }
             ImGui::EndMenu();
         }
         EndMainMenuBar();
 
         drawImGui();
+        if (showProfiler)
+            profilerWindow.draw(&showProfiler);
+        if (showFrameStats)
+            frameStatsWindow.draw(&showFrameStats, frameStats);
+        if (showAllocations)
+            allocationsWindow.draw(&showAllocations, frameAllocations);
+        if (showCounters)
+            countersWindow.draw(&showCounters, frameStats);
 
         ImGui::EndFrame();
         ImGui::Render();
+        imguiVertices.add(ImGui::GetDrawData()->TotalVtxCount);
+        imguiIndices.add(ImGui::GetDrawData()->TotalIdxCount);
+        PROFILE_ZONE("imgui render");
+        GpuTimer::Scope gpu(gpuTimer, "imgui");
+        // ImGui renders after NanoVG, which leaves the same state every frame
+        ImGui_ImplOpenGL3_SetShadowState(imguiShadowState);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
     }
+    drawTicks += perf::ticks() - start;
 }
 
 void Application::drawImGui()
@@ -293,6 +813,7 @@ void Application::resizeWindow(int width, int height) {
 
 bool Application::screenshot(const char *filename) const {
     std::vector< unsigned char > pixels( width * height * 3 );
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
     glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
     stbi_flip_vertically_on_write(1);
     return (bool)stbi_write_png(filename, width, height, 3, &pixels[0], 0);
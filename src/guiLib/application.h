@@ -5,13 +5,23 @@
 #include <GLFW/glfw3.h>
 
 #include <stdexcept>
-#include <map>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
 #include <nanovg.h>
 
+#include "framepacer.h"
+#include "gputimer.h"
+#include "profilerui.h"
+#include "spscqueue.h"
+
 #pragma warning( disable : 4244 )
 
 inline float get_pixel_ratio();
@@ -56,37 +66,169 @@ public:
     }
 };
 
+// Which keys are held down, indexed by GLFW key code. Unknown keys (-1)
+// are never down.
+class KeyState {
+public:
+    bool operator[](int key) const { return key >= 0 && key <= GLFW_KEY_LAST && keys.test(key); }
+
+    void set(int key, bool down) {
+        if (key >= 0 && key <= GLFW_KEY_LAST)
+            keys.set(key, down);
+    }
+
+    void clear() { keys.reset(); }
+
+private:
+    std::bitset<GLFW_KEY_LAST + 1> keys;
+};
+
+// An input event as reported by GLFW, after ImGui had its say.
+struct InputEvent {
+    enum Type : uint8_t {
+        KEY,
+        MOUSE_BUTTON,
+        CURSOR,
+        SCROLL,
+    };
+
+    Type type = KEY;
+    int button = 0; // key or mouse button
+    int action = 0, mods = 0;
+    double x = 0, y = 0; // cursor position or scroll offset
+    double time = 0;     // glfwGetTime() when it was reported
+};
+
+// Settings for running an Application without a window, see run(). Without
+// any limit it runs until the process is stopped.
+struct HeadlessOptions {
+    long steps = 1000;  // stop after this many steps (0: no limit)
+    double seconds = 0; // stop after this much wall time (0: no limit)
+};
+
+// Settings for rendering into an offscreen framebuffer without a window or
+// display, see run(). Needs a build with CMM_BUILD_OFFSCREEN.
+struct OffscreenOptions {
+    long frames = 100;  // stop after this many frames (0: no limit)
+    double seconds = 0; // stop after this much wall time (0: no limit)
+    // if set, a printf pattern with one integer (the frame) to screenshot
+    // every frame to, e.g. "frame%04d.png"
+    std::string outputPattern;
+};
+
+class OffscreenContext;
+class InputRecorder;
+class InputReplay;
+
 // Sets up a GLFW window, its callbacks and ImGui
 class Application {
 public:
-    GLFWwindow *window;
+    GLFWwindow *window = nullptr;
     int width, height;
-    float pixelRatio;
+    float pixelRatio = 1.f;
 
-    struct NVGcontext* vg;
+    struct NVGcontext* vg = nullptr;
+
+    // no window, GL or ImGui; run() only steps process()
+    const bool headless = false;
+    HeadlessOptions headlessOptions;
+
+    // no window; draw() renders into an offscreen framebuffer
+    const bool offscreen = false;
+    OffscreenOptions offscreenOptions;
 
 //    float clearColor[3] = { 0.1f, 0.1f, 0.1f };
     float clearColor[3] = { .9f, .9f, .9f };
 
     MouseState mouseState;
-    std::map<int, bool> keyDown;
+    KeyState keyDown;
 
     // timing
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
 
+    // fixed-timestep simulation: process() advances the simulation by
+    // timeStep and is called as often as needed to catch up with real time,
+    // at most maxStepsPerFrame times per frame (the rest is dropped).
+    float timeStep = 1.f / 60.f;
+    int maxStepsPerFrame = 5;
+    // how far real time is ahead of the simulation, in [0, 1) steps; draw
+    // code can use it to interpolate between the last two simulation states
+    float interpolationAlpha = 0.f;
+
+    // run process() on a dedicated simulation thread (set before run()).
+    // Input events are then handled on the simulation thread right before
+    // each step, and the render thread must only read what publishState()
+    // hands over (see TripleBuffer); interpolationAlpha stays at 1.
+    bool simulationThread = false;
+
+    // run each frame as a task graph (input, simulate, cull, build draw
+    // lists, submit) on a work-stealing pool, simulating frame N+1 while the
+    // draw lists of frame N are built. As with the simulation thread, only
+    // the state handed over by publishState() may be drawn. Ignored if
+    // simulationThread is set.
+    bool pipelinedFrames = false;
+
+    // when the render loop starts a frame; a target rate turns vsync off
+    FramePacer framePacer;
+
+    // only redraw when needed: the loop blocks until input arrives, isDirty()
+    // reports a change, requestRedraw() is called or a requestRedrawIn()
+    // deadline passes
+    bool renderOnDemand = false;
+
+    // show the profiler timeline (see PROFILE_ZONE)
+    bool showProfiler = false;
+    // frame, process and draw times with quantiles and captured spikes
+    perf::FrameStats frameStats;
+    bool showFrameStats = false;
+    // heap allocations of the last frame, with CMM_TRACK_ALLOCATIONS
+    perf::AllocCounters frameAllocations;
+    bool showAllocations = false;
+    // workload counters per frame (see counters.h) next to frame times
+    bool showCounters = false;
+    // GPU time of the clear, NanoVG and ImGui stages of draw(); subclasses
+    // can time their own draws with GpuTimer::Scope outside of those
+    GpuTimer gpuTimer;
+    // let the ImGui backend keep its VAO and restore GL state from a copy
+    // instead of querying it every frame; subclasses that change GL state
+    // between frames in other ways should turn this off
+    bool imguiShadowState = true;
+
 public:
     Application(const char *title, int width, int height, std::string iconPath = CMM_ASSETS_FOLDER"/crl_icon_blue.png", std::string font_path = IMGUI_FONT_FOLDER"/Cousine-Regular.ttf");
+    // headless application, works without a display
+    Application(const char *title, int width, int height, const HeadlessOptions &options);
+    // renders offscreen through a surfaceless EGL context, e.g. on Mesa llvmpipe
+    Application(const char *title, int width, int height, const OffscreenOptions &options);
 
     virtual ~Application();
 
     virtual void setCallbacks();
     virtual void run();
     virtual void process();
+    // runs as many process() steps as dt makes due, returns how many
+    int advance(float dt);
+    // called after every process(), on the thread that ran it
+    virtual void publishState() { }
+    // called on the render thread before draw()
+    virtual void acquireState() { }
+    // prepare what draw() submits from the acquired state; with
+    // pipelinedFrames these run on worker threads
+    virtual void cull() { }
+    virtual void buildDrawLists() { }
     virtual void draw();
     virtual void drawImGui();
     virtual void drawNanoVG();
     virtual void resizeWindow(int width, int height);
+    // with renderOnDemand, whether the last process() changed anything that
+    // is drawn; called on the thread that ran it
+    virtual bool isDirty() { return false; }
+    // wake the render loop for another frame; may be called from any thread
+    void requestRedraw();
+    // redraw no later than the given number of seconds from now, e.g. for
+    // the next frame of an animation
+    void requestRedrawIn(double seconds);
 
     virtual void keyPressed(int key, int mods) { }
     virtual void keyReleased(int key, int mods) { }
@@ -96,5 +238,61 @@ public:
     virtual void scrollWheel(double xoffset, double yoffset) { }
     virtual void drop(int count, const char** filenames) { }
 
+    // handles an input event now or, with a simulation thread, queues it
+    // for one of its next steps
+    void postEvent(const InputEvent &e);
+    void dispatchEvent(const InputEvent &e);
+
     bool screenshot(const char *filename) const;
+
+    // log every dispatched input event and every frame time to path (see
+    // InputRecorder); call before run()
+    bool startRecording(const std::string &path);
+    // replay a recording instead of live input: its events are dispatched
+    // and its frame times fed to advance(), at the recorded pace or, with
+    // maxSpeed, as fast as possible. run() returns at the end of the
+    // recording. Frames are rendered continuously while replaying, whatever
+    // renderOnDemand says, so every recorded frame time reaches advance().
+    // Call before run().
+    bool startReplay(const std::string &path, bool maxSpeed = false);
+
+private:
+    void simulationLoop();
+    void runPipelined();
+    void runHeadless();
+    void runOffscreen();
+    void initRendering(const std::string &font);
+    void updateDeltaTime();
+    void swapBuffers();
+    void applySwapInterval();
+    void waitEvents();
+    void markFrame();
+    bool replayFrame();
+
+    bool vsync = true;
+    std::atomic<bool> redrawRequested{true};
+    std::atomic<double> redrawDeadline{HUGE_VAL};
+    int settleFrames = 0;
+    float accumulator = 0.f;
+    float stepAlpha = 0.f;
+
+    std::unique_ptr<OffscreenContext> offscreenContext;
+    ProfilerWindow profilerWindow;
+    FrameStatsWindow frameStatsWindow;
+    AllocationsWindow allocationsWindow;
+    CountersWindow countersWindow;
+    perf::AllocCounters allocationsAtFrame;
+    std::atomic<uint64_t> processTicks{0};
+    uint64_t drawTicks = 0;
+
+    std::unique_ptr<InputRecorder> recorder;
+    std::chrono::steady_clock::time_point recordStart;
+    std::unique_ptr<InputReplay> replay;
+    bool replayMaxSpeed = false;
+    std::chrono::steady_clock::time_point replayStart;
+    double replayTime = 0;
+
+    std::thread simThread;
+    std::atomic<bool> simRunning{false};
+    SPSCQueue<InputEvent, 1024> simEvents;
 };
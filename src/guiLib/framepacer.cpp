@@ -0,0 +1,120 @@
+#include "framepacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+double FramePacer::now() {
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// sleeps until the monotonic time t, usually wakes up a little late
+static void sleepUntil(double t) {
+#ifdef __linux__
+    // absolute, so time spent before sleeping does not add up
+    timespec ts;
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - (double)ts.tv_sec) * 1e9);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+#else
+    double remaining = t - FramePacer::now();
+    if (remaining > 0)
+        std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+#endif
+}
+
+void FramePacer::waitUntil(double t) {
+    double sleepEnd = t - spinMargin;
+    if (sleepEnd > now()) {
+        sleepUntil(sleepEnd);
+        // keep the spin margin around twice the typical oversleep
+        double late = now() - sleepEnd;
+        spinMargin = std::min(std::max(0.95 * spinMargin + 0.1 * late, 2e-4), 4e-3);
+    }
+    while (now() < t)
+        CPU_RELAX();
+}
+
+void FramePacer::waitForFrame() {
+    const double p = period();
+    const double t = now();
+
+    double start = t;
+    if (targetRate > 0) {
+        deadline += p;
+        // more than a frame behind: start over instead of catching up
+        if (t - deadline > p)
+            deadline = t;
+        start = deadline;
+    } else {
+        // vsync: due one refresh after the last present
+        deadline = lastPresent + p;
+    }
+    if (mode == LOW_LATENCY)
+        start = deadline - (workMean + 2 * workDeviation + safetyMargin);
+
+    if (start > t)
+        waitUntil(start);
+    frameStart = now();
+}
+
+void FramePacer::framePresented() {
+    const double t = now();
+
+    if (frameStart > 0) {
+        double work = t - frameStart;
+        workDeviation = 0.9 * workDeviation + 0.1 * std::abs(work - workMean);
+        workMean = 0.9 * workMean + 0.1 * work;
+        pacingStats.workTime = workMean;
+    }
+
+    if (lastPresent > 0) {
+        intervals[nextInterval] = t - lastPresent;
+        nextInterval = (nextInterval + 1) % WINDOW;
+        numIntervals = std::min(numIntervals + 1, (int)WINDOW);
+
+        const double p = period();
+        double sum = 0, sumSq = 0, maxError = 0;
+        int missed = 0;
+        for (int i = 0; i < numIntervals; i++) {
+            sum += intervals[i];
+            sumSq += intervals[i] * intervals[i];
+            maxError = std::max(maxError, std::abs(intervals[i] - p));
+            if (intervals[i] > 1.5 * p)
+                missed++;
+        }
+        double mean = sum / numIntervals;
+        pacingStats.meanError = mean - p;
+        pacingStats.jitter = std::sqrt(std::max(sumSq / numIntervals - mean * mean, 0.0));
+        pacingStats.maxError = maxError;
+        pacingStats.missed = missed;
+    }
+    lastPresent = t;
+}
+
+void FramePacer::resetStats() {
+    numIntervals = nextInterval = 0;
+    double workTime = pacingStats.workTime;
+    pacingStats = PacingStats();
+    pacingStats.workTime = workTime;
+}
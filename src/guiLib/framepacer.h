@@ -0,0 +1,64 @@
+#pragma once
+
+// Pacing error over the last FramePacer::WINDOW presented frames, in seconds.
+// The error of a frame is its interval minus the target period.
+struct PacingStats {
+    double meanError = 0;
+    double jitter = 0;   // standard deviation of the intervals
+    double maxError = 0; // largest absolute error
+    int missed = 0;      // intervals longer than 1.5 periods
+    double workTime = 0; // predicted time from input sampling to present
+};
+
+// Decides when the render loop starts its next frame. With a target rate it
+// is a frame limiter (the loop should turn vsync off): it sleeps until
+// shortly before the deadline with an absolute clock_nanosleep, then spins
+// the rest, so neither a core burns nor does the wake-up jitter. In
+// LOW_LATENCY mode the frame is started as late as possible, i.e. the
+// predicted work time before it is due (at the deadline or the next vsync),
+// so input is sampled just in time for rendering.
+class FramePacer {
+public:
+    enum Mode {
+        THROUGHPUT,
+        LOW_LATENCY,
+    };
+
+    static const int WINDOW = 120;
+
+    Mode mode = THROUGHPUT;
+    // frames per second, 0 leaves pacing to vsync
+    double targetRate = 0;
+    // of the display, paces LOW_LATENCY mode without a target rate
+    double refreshRate = 60;
+    // extra time kept free before a LOW_LATENCY deadline
+    double safetyMargin = 0.001;
+
+    // true if waitForFrame() may block
+    bool active() const { return targetRate > 0 || mode == LOW_LATENCY; }
+
+    // blocks until the next frame should sample its input
+    void waitForFrame();
+    // call right after the frame was presented (buffers swapped)
+    void framePresented();
+
+    const PacingStats &stats() const { return pacingStats; }
+    void resetStats();
+
+    // monotonic time in seconds
+    static double now();
+
+private:
+    double period() const { return 1.0 / ((targetRate > 0) ? targetRate : refreshRate); }
+    void waitUntil(double t);
+
+    double deadline = 0;     // when the current frame is due
+    double frameStart = 0;   // when the current frame sampled its input
+    double lastPresent = 0;
+    double workMean = 0, workDeviation = 0;
+    double spinMargin = 0.001;
+
+    double intervals[WINDOW] = {};
+    int numIntervals = 0, nextInterval = 0;
+    PacingStats pacingStats;
+};
@@ -0,0 +1,69 @@
+#include "glcounters.h"
+
+#include <glad/glad.h>
+
+#include <counters.h>
+
+namespace {
+
+perf::Counter drawCalls("gl/draw calls");
+
+PFNGLDRAWARRAYSPROC drawArrays;
+PFNGLDRAWELEMENTSPROC drawElements;
+PFNGLDRAWRANGEELEMENTSPROC drawRangeElements;
+PFNGLDRAWELEMENTSBASEVERTEXPROC drawElementsBaseVertex;
+PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced;
+
+void APIENTRY countedDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    drawCalls.add();
+    drawArrays(mode, first, count);
+}
+
+void APIENTRY countedDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {
+    drawCalls.add();
+    drawElements(mode, count, type, indices);
+}
+
+void APIENTRY countedDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type,
+                                       const void *indices) {
+    drawCalls.add();
+    drawRangeElements(mode, start, end, count, type, indices);
+}
+
+void APIENTRY countedDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices,
+                                            GLint baseVertex) {
+    drawCalls.add();
+    drawElementsBaseVertex(mode, count, type, indices, baseVertex);
+}
+
+void APIENTRY countedDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    drawCalls.add();
+    drawArraysInstanced(mode, first, count, instances);
+}
+
+void APIENTRY countedDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices,
+                                           GLsizei instances) {
+    drawCalls.add();
+    drawElementsInstanced(mode, count, type, indices, instances);
+}
+
+// replaces a loaded function with its counting version, once
+template <typename F>
+void wrap(F &function, F &original, F counted) {
+    if (!function || function == counted)
+        return;
+    original = function;
+    function = counted;
+}
+
+} // namespace
+
+void countGLDrawCalls() {
+    wrap(glad_glDrawArrays, drawArrays, &countedDrawArrays);
+    wrap(glad_glDrawElements, drawElements, &countedDrawElements);
+    wrap(glad_glDrawRangeElements, drawRangeElements, &countedDrawRangeElements);
+    wrap(glad_glDrawElementsBaseVertex, drawElementsBaseVertex, &countedDrawElementsBaseVertex);
+    wrap(glad_glDrawArraysInstanced, drawArraysInstanced, &countedDrawArraysInstanced);
+    wrap(glad_glDrawElementsInstanced, drawElementsInstanced, &countedDrawElementsInstanced);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Counts the OpenGL draw calls of every frame into the "gl/draw calls"
+// counter (see counters.h) by wrapping glad's draw function pointers, so
+// NanoVG, ImGui and the application's own draws are all included. Call
+// once after glad has loaded the functions.
+void countGLDrawCalls();
@@ -0,0 +1,43 @@
+#include "glext.h"
+
+#include <cstring>
+
+PFNGLBUFFERSTORAGEPROC glext_glBufferStorage = nullptr;
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = nullptr;
+
+namespace {
+
+bool hasVersion(int major, int minor) {
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+} // namespace
+
+bool hasGLExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void loadGLExtensions(GLADloadproc load) {
+    // the ARB extensions have the same entry points as core
+    glext_glBufferStorage = nullptr;
+    if (hasVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage"))
+        glext_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+
+    glext_glGetProgramBinary = nullptr;
+    glext_glProgramBinary = nullptr;
+    glext_glProgramParameteri = nullptr;
+    if (hasVersion(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+        glext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        glext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+        glext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    }
+}
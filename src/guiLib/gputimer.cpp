@@ -0,0 +1,84 @@
+#include "gputimer.h"
+
+#include <algorithm>
+
+void GpuTimer::beginFrame() {
+    if (!initialized) {
+        for (auto &f : frames)
+            glGenQueries(MAX_STAGES, f.queries);
+        ring = &perf::Profiler::instance().createRing("gpu");
+        initialized = true;
+    }
+    end();
+
+    // oldest first, stop at the first that is not done yet to keep order
+    const int n = LATENCY + 1;
+    for (int i = 1; i <= n; ++i) {
+        Frame &f = frames[(current + i) % n];
+        if (f.pending && !collect(f))
+            break;
+    }
+
+    current = (current + 1) % n;
+    Frame &f = frames[current];
+    if (f.pending) {
+        // LATENCY frames were not enough, reuse the queries anyway
+        f.pending = false;
+        missed++;
+    }
+    f.count = 0;
+}
+
+void GpuTimer::begin(const char *name) {
+    end();
+    if (current < 0)
+        return;
+    Frame &f = frames[current];
+    if (f.count == MAX_STAGES)
+        return;
+    f.names[f.count] = name;
+    f.submitted[f.count] = perf::ticks();
+    glBeginQuery(GL_TIME_ELAPSED, f.queries[f.count]);
+    f.count++;
+    f.pending = true;
+    open = true;
+}
+
+void GpuTimer::end() {
+    if (!open)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    open = false;
+}
+
+bool GpuTimer::collect(Frame &f) {
+    // the last query finishes last
+    GLint available = 0;
+    glGetQueryObjectiv(f.queries[f.count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+    f.pending = false;
+
+    // llvmpipe reports the time since context creation for the very first
+    // query, throw the first frame away
+    if (!warmedUp) {
+        warmedUp = true;
+        return true;
+    }
+
+    latest.clear();
+    const double ticksPerNs = perf::ticksPerSecond() * 1e-9;
+    for (int i = 0; i < f.count; ++i) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(f.queries[i], GL_QUERY_RESULT, &ns);
+        latest.push_back({f.names[i], ns * 1e-6});
+
+        perf::ZoneEvent e;
+        e.name = f.names[i];
+        e.begin = std::max(f.submitted[i], gpuEnd);
+        e.end = e.begin + (uint64_t)(ns * ticksPerNs);
+        gpuEnd = e.end;
+        ring->push(e);
+    }
+    return true;
+}
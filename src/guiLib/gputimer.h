@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <profiler.h>
+
+// GPU time of named stages with GL_TIME_ELAPSED queries. Queries of a frame
+// are read LATENCY frames later, and only if the GPU has finished them, so
+// measuring never stalls the pipeline. Results also go to a "gpu" lane of
+// the profiler, placed at the CPU time the stage was submitted (stages run
+// in order on the GPU, so each starts no earlier than the previous ended).
+// Elapsed-time queries cannot nest: begin() ends an open stage first.
+class GpuTimer {
+public:
+    static const int LATENCY = 3;
+    static const int MAX_STAGES = 16;
+
+    struct Result {
+        const char *name;
+        double ms;
+    };
+
+    // times a stage for the rest of the scope
+    class Scope {
+    public:
+        Scope(GpuTimer &timer, const char *name) : timer(timer) { timer.begin(name); }
+        ~Scope() { timer.end(); }
+
+    private:
+        GpuTimer &timer;
+    };
+
+    // starts a frame and collects the finished results of earlier ones;
+    // needs a current GL context
+    void beginFrame();
+    void begin(const char *name);
+    void end();
+
+    // stages of the latest frame with results
+    const std::vector<Result> &results() const { return latest; }
+    // frames whose results were not available in time and got dropped
+    long missedFrames() const { return missed; }
+
+private:
+    struct Frame {
+        GLuint queries[MAX_STAGES] = {};
+        const char *names[MAX_STAGES] = {};
+        uint64_t submitted[MAX_STAGES] = {};
+        int count = 0;
+        bool pending = false;
+    };
+
+    bool collect(Frame &frame);
+
+    Frame frames[LATENCY + 1];
+    int current = -1;
+    bool open = false;
+    bool initialized = false;
+    bool warmedUp = false;
+
+    std::vector<Result> latest;
+    perf::ThreadRing *ring = nullptr;
+    uint64_t gpuEnd = 0;
+    long missed = 0;
+};
@@ -54,6 +54,7 @@
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <string.h>     // memcpy
 #if defined(_MSC_VER) && _MSC_VER <= 1500 // MSVC 2008 or earlier
 #include <stddef.h>     // intptr_t
 #else
@@ -83,6 +84,8 @@
 #include <GL/glew.h>
 #elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
 #include <glad/glad.h>
+#include "glext.h"      // glBufferStorage
+#define IMGUI_IMPL_OPENGL_HAS_BUFFER_STORAGE
 #else
 #include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
 #endif
@@ -96,6 +99,39 @@ static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
 static unsigned int g_VboHandle = 0, g_ElementsHandle = 0;
 
+// Streaming uploads: instead of a glBufferData() per command list, the vertices and indices of all lists are uploaded
+// once per frame. With ImGui_ImplOpenGL3_Upload_Persistent the buffers hold STREAM_REGIONS regions and are mapped once,
+// persistently; each frame writes the next region after waiting for the fence of the frame that last drew from it,
+// which the GPU has long finished in the common case. With ImGui_ImplOpenGL3_Upload_Orphan each frame orphans the
+// buffers and fills them with glBufferSubData(), letting the driver hand out fresh storage.
+enum { STREAM_REGIONS = 3 };
+static ImGui_ImplOpenGL3_Upload g_Upload = ImGui_ImplOpenGL3_Upload_Persistent;     // as requested
+static ImGui_ImplOpenGL3_Upload g_StreamUpload = ImGui_ImplOpenGL3_Upload_PerList;  // the buffers were created for
+static int          g_StreamVtxCapacity = 0, g_StreamIdxCapacity = 0;               // per region, in vertices/indices
+static char*        g_StreamVtxMapped = NULL;
+static char*        g_StreamIdxMapped = NULL;
+static GLsync       g_StreamFences[STREAM_REGIONS] = {};
+static int          g_StreamRegion = 0;
+static int          g_StreamGeneration = 0;     // of the buffers, incremented when they are recreated
+
+// The GL state the render function changes, to restore it afterwards. By default it is queried with glGet*() before
+// every render. In shadow mode (ImGui_ImplOpenGL3_SetShadowState) it is queried once and assumed to be the same on
+// every later render, so the queries, which may stall on the driver, and the per-frame VAO drop out of the frame.
+struct GLState
+{
+    GLenum      active_texture;
+    GLint       program, texture, sampler, array_buffer, vertex_array;
+    GLint       polygon_mode[2], viewport[4], scissor_box[4];
+    GLenum      blend_src_rgb, blend_dst_rgb, blend_src_alpha, blend_dst_alpha, blend_equation_rgb, blend_equation_alpha;
+    GLboolean   enable_blend, enable_cull_face, enable_depth_test, enable_scissor_test;
+};
+static bool         g_ShadowState = false;
+static bool         g_ShadowValid = false;
+static int          g_ShadowFbWidth = 0, g_ShadowFbHeight = 0;  // the shadow is retaken when the framebuffer resizes
+static GLState      g_Shadow = {};
+static GLuint       g_CachedVao = 0;
+static int          g_CachedVaoGeneration = -1;                 // of the buffers the cached VAO points to
+
 // Functions
 bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
 {
@@ -124,6 +160,177 @@ void    ImGui_ImplOpenGL3_NewFrame()
         ImGui_ImplOpenGL3_CreateDeviceObjects();
 }
 
+void    ImGui_ImplOpenGL3_SetUpload(ImGui_ImplOpenGL3_Upload upload)
+{
+    g_Upload = upload;
+}
+
+void    ImGui_ImplOpenGL3_SetShadowState(bool enable)
+{
+    if (enable != g_ShadowState)
+        g_ShadowValid = false;
+    g_ShadowState = enable;
+}
+
+void    ImGui_ImplOpenGL3_InvalidateState()
+{
+    g_ShadowValid = false;
+}
+
+ImGui_ImplOpenGL3_Upload ImGui_ImplOpenGL3_GetUpload()
+{
+#ifdef USE_GL_ES3
+    return ImGui_ImplOpenGL3_Upload_PerList; // no glDrawElementsBaseVertex() before ES 3.2
+#else
+#ifdef IMGUI_IMPL_OPENGL_HAS_BUFFER_STORAGE
+    if (g_Upload == ImGui_ImplOpenGL3_Upload_Persistent && glBufferStorage == NULL)
+#else
+    if (g_Upload == ImGui_ImplOpenGL3_Upload_Persistent)
+#endif
+        return ImGui_ImplOpenGL3_Upload_Orphan;
+    return g_Upload;
+#endif
+}
+
+static void DestroyStreamBuffers()
+{
+    for (int i = 0; i < STREAM_REGIONS; i++)
+    {
+        if (g_StreamFences[i])
+            glDeleteSync(g_StreamFences[i]);
+        g_StreamFences[i] = 0;
+    }
+    // Deleting a mapped buffer unmaps it, and the driver keeps the storage alive for draws still in flight
+    if (g_VboHandle) glDeleteBuffers(1, &g_VboHandle);
+    if (g_ElementsHandle) glDeleteBuffers(1, &g_ElementsHandle);
+    g_VboHandle = g_ElementsHandle = 0;
+    g_StreamVtxMapped = g_StreamIdxMapped = NULL;
+    g_StreamVtxCapacity = g_StreamIdxCapacity = 0;
+    g_StreamRegion = 0;
+    g_StreamGeneration++;
+}
+
+// (Re)creates the buffers for an upload mode and at least that many vertices and indices per region. Binds them, with
+// a vertex array bound since the element array binding is part of it.
+static void CreateStreamBuffers(ImGui_ImplOpenGL3_Upload upload, int vtx_count, int idx_count)
+{
+    DestroyStreamBuffers();
+    // Grow geometrically, so a growing UI reallocates a few times only
+    g_StreamVtxCapacity = 1 << 14;
+    while (g_StreamVtxCapacity < vtx_count)
+        g_StreamVtxCapacity *= 2;
+    g_StreamIdxCapacity = 1 << 15;
+    while (g_StreamIdxCapacity < idx_count)
+        g_StreamIdxCapacity *= 2;
+    g_StreamUpload = upload;
+
+    glGenBuffers(1, &g_VboHandle);
+    glGenBuffers(1, &g_ElementsHandle);
+    glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+    GLsizeiptr vtx_size = (GLsizeiptr)g_StreamVtxCapacity * sizeof(ImDrawVert);
+    GLsizeiptr idx_size = (GLsizeiptr)g_StreamIdxCapacity * sizeof(ImDrawIdx);
+#ifdef IMGUI_IMPL_OPENGL_HAS_BUFFER_STORAGE
+    if (upload == ImGui_ImplOpenGL3_Upload_Persistent)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, vtx_size * STREAM_REGIONS, NULL, flags);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, idx_size * STREAM_REGIONS, NULL, flags);
+        g_StreamVtxMapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vtx_size * STREAM_REGIONS, flags);
+        g_StreamIdxMapped = (char*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, idx_size * STREAM_REGIONS, flags);
+        if (g_StreamVtxMapped && g_StreamIdxMapped)
+            return;
+        // The driver has buffer storage but would not map it, stay with orphaning
+        g_Upload = ImGui_ImplOpenGL3_Upload_Orphan;
+        CreateStreamBuffers(ImGui_ImplOpenGL3_Upload_Orphan, vtx_count, idx_count);
+        return;
+    }
+#endif
+    glBufferData(GL_ARRAY_BUFFER, vtx_size, NULL, GL_STREAM_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_size, NULL, GL_STREAM_DRAW);
+}
+
+static void BackupState(GLState& s)
+{
+    glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&s.active_texture);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &s.program);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &s.texture);
+#ifdef GL_SAMPLER_BINDING
+    glGetIntegerv(GL_SAMPLER_BINDING, &s.sampler);
+#endif
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &s.array_buffer);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &s.vertex_array);
+#ifdef GL_POLYGON_MODE
+    glGetIntegerv(GL_POLYGON_MODE, s.polygon_mode);
+#endif
+    glGetIntegerv(GL_VIEWPORT, s.viewport);
+    glGetIntegerv(GL_SCISSOR_BOX, s.scissor_box);
+    glGetIntegerv(GL_BLEND_SRC_RGB, (GLint*)&s.blend_src_rgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, (GLint*)&s.blend_dst_rgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint*)&s.blend_src_alpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint*)&s.blend_dst_alpha);
+    glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint*)&s.blend_equation_rgb);
+    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint*)&s.blend_equation_alpha);
+    s.enable_blend = glIsEnabled(GL_BLEND);
+    s.enable_cull_face = glIsEnabled(GL_CULL_FACE);
+    s.enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
+    s.enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+}
+
+static void SetEnabled(GLenum cap, GLboolean enabled)
+{
+    if (enabled) glEnable(cap); else glDisable(cap);
+}
+
+// Restores the state "last" where it differs from "set", the state the render function left, or all of it
+static void RestoreState(const GLState& last, const GLState& set, bool all)
+{
+    if (all || last.program != set.program)
+        glUseProgram(last.program);
+    if (all || last.texture != set.texture)
+        glBindTexture(GL_TEXTURE_2D, last.texture);
+#ifdef GL_SAMPLER_BINDING
+    if (all || last.sampler != set.sampler)
+        glBindSampler(0, last.sampler);
+#endif
+    if (all || last.active_texture != set.active_texture)
+        glActiveTexture(last.active_texture);
+    if (all || last.vertex_array != set.vertex_array)
+        glBindVertexArray(last.vertex_array);
+    if (all || last.array_buffer != set.array_buffer)
+        glBindBuffer(GL_ARRAY_BUFFER, last.array_buffer);
+    if (all || last.blend_equation_rgb != set.blend_equation_rgb || last.blend_equation_alpha != set.blend_equation_alpha)
+        glBlendEquationSeparate(last.blend_equation_rgb, last.blend_equation_alpha);
+    if (all || last.blend_src_rgb != set.blend_src_rgb || last.blend_dst_rgb != set.blend_dst_rgb ||
+        last.blend_src_alpha != set.blend_src_alpha || last.blend_dst_alpha != set.blend_dst_alpha)
+        glBlendFuncSeparate(last.blend_src_rgb, last.blend_dst_rgb, last.blend_src_alpha, last.blend_dst_alpha);
+    if (all || last.enable_blend != set.enable_blend) SetEnabled(GL_BLEND, last.enable_blend);
+    if (all || last.enable_cull_face != set.enable_cull_face) SetEnabled(GL_CULL_FACE, last.enable_cull_face);
+    if (all || last.enable_depth_test != set.enable_depth_test) SetEnabled(GL_DEPTH_TEST, last.enable_depth_test);
+    if (all || last.enable_scissor_test != set.enable_scissor_test) SetEnabled(GL_SCISSOR_TEST, last.enable_scissor_test);
+#ifdef GL_POLYGON_MODE
+    if (all || last.polygon_mode[0] != set.polygon_mode[0])
+        glPolygonMode(GL_FRONT_AND_BACK, (GLenum)last.polygon_mode[0]);
+#endif
+    if (all || memcmp(last.viewport, set.viewport, sizeof(last.viewport)) != 0)
+        glViewport(last.viewport[0], last.viewport[1], (GLsizei)last.viewport[2], (GLsizei)last.viewport[3]);
+    if (all || memcmp(last.scissor_box, set.scissor_box, sizeof(last.scissor_box)) != 0)
+        glScissor(last.scissor_box[0], last.scissor_box[1], (GLsizei)last.scissor_box[2], (GLsizei)last.scissor_box[3]);
+}
+
+// Waits until the GPU is done with the draws of the frame that last wrote a region
+static void WaitStreamRegion(int region)
+{
+    GLsync& fence = g_StreamFences[region];
+    if (!fence)
+        return;
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+    glDeleteSync(fence);
+    fence = 0;
+}
+
 // OpenGL3 Render function.
 // (this used to be set in io.RenderDrawListsFn and called by ImGui::Render(), but you can now call this directly from your main loop)
 // Note that this implementation is little overcomplicated because we are saving/setting up/restoring every OpenGL state explicitly, in order to be able to run within any OpenGL engine that doesn't do so.
@@ -137,45 +344,44 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         return;
     draw_data->ScaleClipRects(io.DisplayFramebufferScale);
 
-    // Backup GL state
-    GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
+    // Backup GL state: queried every frame, or in shadow mode once and then taken from the shadow
+    if (!g_ShadowState || !g_ShadowValid || fb_width != g_ShadowFbWidth || fb_height != g_ShadowFbHeight)
+    {
+        BackupState(g_Shadow);
+        g_ShadowValid = g_ShadowState;
+        g_ShadowFbWidth = fb_width;
+        g_ShadowFbHeight = fb_height;
+    }
+    const GLState& last = g_Shadow;
+
+    // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill.
+    // "set" is the state we leave behind, restoring only what differs from "last" afterwards.
+    GLState set = last;
+    set.active_texture = GL_TEXTURE0;
     glActiveTexture(GL_TEXTURE0);
-    GLint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
-    GLint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-#ifdef GL_SAMPLER_BINDING
-    GLint last_sampler; glGetIntegerv(GL_SAMPLER_BINDING, &last_sampler);
-#endif
-    GLint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-    GLint last_vertex_array; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
-#ifdef GL_POLYGON_MODE
-    GLint last_polygon_mode[2]; glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
-#endif
-    GLint last_viewport[4]; glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4]; glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLenum last_blend_src_rgb; glGetIntegerv(GL_BLEND_SRC_RGB, (GLint*)&last_blend_src_rgb);
-    GLenum last_blend_dst_rgb; glGetIntegerv(GL_BLEND_DST_RGB, (GLint*)&last_blend_dst_rgb);
-    GLenum last_blend_src_alpha; glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint*)&last_blend_src_alpha);
-    GLenum last_blend_dst_alpha; glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint*)&last_blend_dst_alpha);
-    GLenum last_blend_equation_rgb; glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint*)&last_blend_equation_rgb);
-    GLenum last_blend_equation_alpha; glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint*)&last_blend_equation_alpha);
-    GLboolean last_enable_blend = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
-
-    // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill
+    set.enable_blend = GL_TRUE;
     glEnable(GL_BLEND);
+    set.blend_equation_rgb = set.blend_equation_alpha = GL_FUNC_ADD;
     glBlendEquation(GL_FUNC_ADD);
+    set.blend_src_rgb = set.blend_src_alpha = GL_SRC_ALPHA;
+    set.blend_dst_rgb = set.blend_dst_alpha = GL_ONE_MINUS_SRC_ALPHA;
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    set.enable_cull_face = GL_FALSE;
     glDisable(GL_CULL_FACE);
+    set.enable_depth_test = GL_FALSE;
     glDisable(GL_DEPTH_TEST);
+    set.enable_scissor_test = GL_TRUE;
     glEnable(GL_SCISSOR_TEST);
 #ifdef GL_POLYGON_MODE
+    set.polygon_mode[0] = set.polygon_mode[1] = GL_FILL;
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
 
     // Setup viewport, orthographic projection matrix
     // Our visible imgui space lies from draw_data->DisplayPps (top left) to draw_data->DisplayPos+data_data->DisplaySize (bottom right). DisplayMin is typically (0,0) for single viewport apps.
+    set.viewport[0] = set.viewport[1] = 0;
+    set.viewport[2] = fb_width;
+    set.viewport[3] = fb_height;
     glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
     float L = draw_data->DisplayPos.x;
     float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
@@ -188,37 +394,106 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         { 0.0f,         0.0f,        -1.0f,   0.0f },
         { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
     };
+    set.program = g_ShaderHandle;
     glUseProgram(g_ShaderHandle);
     glUniform1i(g_AttribLocationTex, 0);
     glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
 #ifdef GL_SAMPLER_BINDING
+    set.sampler = 0;
     glBindSampler(0, 0); // We use combined texture/sampler state. Applications using GL 3.3 may set that otherwise.
 #endif
-    // Recreate the VAO every time
+    // Recreate the VAO every time, or in shadow mode once with the device objects
     // (This is to easily allow multiple GL contexts. VAO are not shared among GL contexts, and we don't track creation/deletion of windows so we don't have an obvious key to use to cache them.)
     GLuint vao_handle = 0;
-    glGenVertexArrays(1, &vao_handle);
+    if (g_ShadowState)
+    {
+        if (!g_CachedVao)
+        {
+            glGenVertexArrays(1, &g_CachedVao);
+            g_CachedVaoGeneration = -1;
+        }
+        vao_handle = g_CachedVao;
+    }
+    else
+    {
+        glGenVertexArrays(1, &vao_handle);
+    }
     glBindVertexArray(vao_handle);
+    ImGui_ImplOpenGL3_Upload upload = ImGui_ImplOpenGL3_GetUpload();
+    if (upload != g_StreamUpload || !g_VboHandle || (upload != ImGui_ImplOpenGL3_Upload_PerList &&
+        (draw_data->TotalVtxCount > g_StreamVtxCapacity || draw_data->TotalIdxCount > g_StreamIdxCapacity)))
+        CreateStreamBuffers(upload, draw_data->TotalVtxCount, draw_data->TotalIdxCount);
+    upload = g_StreamUpload;
+    set.array_buffer = g_VboHandle;
     glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-    glEnableVertexAttribArray(g_AttribLocationPosition);
-    glEnableVertexAttribArray(g_AttribLocationUV);
-    glEnableVertexAttribArray(g_AttribLocationColor);
-    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
-
-    // Draw
+    if (vao_handle != g_CachedVao || g_CachedVaoGeneration != g_StreamGeneration)
+    {
+        // A cached VAO keeps these until the buffers are recreated
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+        glEnableVertexAttribArray(g_AttribLocationPosition);
+        glEnableVertexAttribArray(g_AttribLocationUV);
+        glEnableVertexAttribArray(g_AttribLocationColor);
+        glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
+        glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
+        glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+        if (vao_handle == g_CachedVao)
+            g_CachedVaoGeneration = g_StreamGeneration;
+    }
+
+    // Upload the command lists of the frame at once, one after the other into the region of this frame
+    int region = 0;
+    if (upload == ImGui_ImplOpenGL3_Upload_Persistent)
+    {
+        region = g_StreamRegion;
+        WaitStreamRegion(region);
+        char* vtx_dst = g_StreamVtxMapped + (size_t)region * g_StreamVtxCapacity * sizeof(ImDrawVert);
+        char* idx_dst = g_StreamIdxMapped + (size_t)region * g_StreamIdxCapacity * sizeof(ImDrawIdx);
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+            memcpy(vtx_dst, cmd_list->VtxBuffer.Data, (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+            memcpy(idx_dst, cmd_list->IdxBuffer.Data, (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+            vtx_dst += (size_t)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+            idx_dst += (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        }
+    }
+    else if (upload == ImGui_ImplOpenGL3_Upload_Orphan)
+    {
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_StreamVtxCapacity * sizeof(ImDrawVert), NULL, GL_STREAM_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)g_StreamIdxCapacity * sizeof(ImDrawIdx), NULL, GL_STREAM_DRAW);
+        GLintptr vtx_dst = 0, idx_dst = 0;
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+            GLsizeiptr vtx_size = (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+            GLsizeiptr idx_size = (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+            glBufferSubData(GL_ARRAY_BUFFER, vtx_dst, vtx_size, (const GLvoid*)cmd_list->VtxBuffer.Data);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, idx_dst, idx_size, (const GLvoid*)cmd_list->IdxBuffer.Data);
+            vtx_dst += vtx_size;
+            idx_dst += idx_size;
+        }
+    }
+
+    // Draw, binding textures and setting scissor rectangles only when they change
     ImVec2 pos = draw_data->DisplayPos;
+    GLint vtx_offset = region * g_StreamVtxCapacity;
+    size_t idx_offset = (size_t)region * g_StreamIdxCapacity;
+    bool bound = false;             // whether set.texture and set.scissor_box are what is bound
+    bool restore_all = false;       // after user callbacks, which may change any state
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
         const ImDrawIdx* idx_buffer_offset = 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        if (upload == ImGui_ImplOpenGL3_Upload_PerList)
+        {
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        }
+        else
+        {
+            idx_buffer_offset += idx_offset;
+        }
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -227,6 +502,8 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
             {
                 // User callback (registered via ImDrawList::AddCallback)
                 pcmd->UserCallback(cmd_list, pcmd);
+                bound = false;
+                restore_all = true;
             }
             else
             {
@@ -234,38 +511,50 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.0f && clip_rect.w >= 0.0f)
                 {
                     // Apply scissor/clipping rectangle
-                    glScissor((int)clip_rect.x, (int)(fb_height - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
+                    GLint scissor_box[4] = { (int)clip_rect.x, (int)(fb_height - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y) };
+                    if (!bound || memcmp(scissor_box, set.scissor_box, sizeof(scissor_box)) != 0)
+                    {
+                        glScissor(scissor_box[0], scissor_box[1], scissor_box[2], scissor_box[3]);
+                        memcpy(set.scissor_box, scissor_box, sizeof(scissor_box));
+                    }
 
                     // Bind texture, Draw
-                    glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
+                    GLint texture = (GLint)(intptr_t)pcmd->TextureId;
+                    if (!bound || texture != set.texture)
+                    {
+                        glBindTexture(GL_TEXTURE_2D, (GLuint)texture);
+                        set.texture = texture;
+                    }
+                    bound = true;
+#ifdef USE_GL_ES3
                     glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset);
+#else
+                    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset, vtx_offset);
+#endif
                 }
             }
             idx_buffer_offset += pcmd->ElemCount;
         }
+        if (upload != ImGui_ImplOpenGL3_Upload_PerList)
+        {
+            vtx_offset += cmd_list->VtxBuffer.Size;
+            idx_offset += cmd_list->IdxBuffer.Size;
+        }
+    }
+    if (upload == ImGui_ImplOpenGL3_Upload_Persistent)
+    {
+        g_StreamFences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        g_StreamRegion = (region + 1) % STREAM_REGIONS;
+    }
+    set.vertex_array = (GLint)vao_handle;
+    if (vao_handle != g_CachedVao)
+    {
+        glDeleteVertexArrays(1, &vao_handle);
+        set.vertex_array = 0; // deleting the bound VAO unbinds it
     }
-    glDeleteVertexArrays(1, &vao_handle);
 
     // Restore modified GL state
-    glUseProgram(last_program);
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-#ifdef GL_SAMPLER_BINDING
-    glBindSampler(0, last_sampler);
-#endif
-    glActiveTexture(last_active_texture);
-    glBindVertexArray(last_vertex_array);
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
-    if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
-    if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-    if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
-    if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
-#ifdef GL_POLYGON_MODE
-    glPolygonMode(GL_FRONT_AND_BACK, (GLenum)last_polygon_mode[0]);
-#endif
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+    RestoreState(last, set, restore_all);
 }
 
 bool ImGui_ImplOpenGL3_CreateFontsTexture()
@@ -503,9 +792,7 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
     g_AttribLocationUV = glGetAttribLocation(g_ShaderHandle, "UV");
     g_AttribLocationColor = glGetAttribLocation(g_ShaderHandle, "Color");
 
-    // Create buffers
-    glGenBuffers(1, &g_VboHandle);
-    glGenBuffers(1, &g_ElementsHandle);
+    // Buffers are created by the first render, see CreateStreamBuffers()
 
     ImGui_ImplOpenGL3_CreateFontsTexture();
 
@@ -519,9 +806,10 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
 
 void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
 {
-    if (g_VboHandle) glDeleteBuffers(1, &g_VboHandle);
-    if (g_ElementsHandle) glDeleteBuffers(1, &g_ElementsHandle);
-    g_VboHandle = g_ElementsHandle = 0;
+    DestroyStreamBuffers();
+    if (g_CachedVao) glDeleteVertexArrays(1, &g_CachedVao);
+    g_CachedVao = 0;
+    g_ShadowValid = false;
 
     if (g_ShaderHandle && g_VertHandle) glDetachShader(g_ShaderHandle, g_VertHandle);
     if (g_VertHandle) glDeleteShader(g_VertHandle);
@@ -32,6 +32,23 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data);
 
+// How vertices and indices reach the GPU, see imgui_impl_opengl3.cpp. Defaults to persistent mapping, which falls back
+// to orphaning when the context has no buffer storage (GL 4.4 or ARB_buffer_storage, see glext.h).
+enum ImGui_ImplOpenGL3_Upload
+{
+    ImGui_ImplOpenGL3_Upload_PerList,       // glBufferData() per command list, as upstream
+    ImGui_ImplOpenGL3_Upload_Orphan,        // once per frame into orphaned buffers
+    ImGui_ImplOpenGL3_Upload_Persistent     // once per frame into a persistently mapped ring, synchronized by fences
+};
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_SetUpload(ImGui_ImplOpenGL3_Upload upload);
+IMGUI_IMPL_API ImGui_ImplOpenGL3_Upload ImGui_ImplOpenGL3_GetUpload(); // the mode in use
+
+// Shadow mode: the VAO is created once and the GL state ImGui_ImplOpenGL3_RenderDrawData() changes is queried once, then
+// restored from a CPU-side copy, instead of queried every frame. Only for one GL context, and only if that state is the
+// same at every render; call ImGui_ImplOpenGL3_InvalidateState() when it changes (a resize is detected on its own).
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_SetShadowState(bool enable);
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_InvalidateState();
+
 // Called by Init/NewFrame/Shutdown
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateFontsTexture();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
@@ -0,0 +1,140 @@
+#include "inputrecorder.h"
+
+namespace {
+
+const char MAGIC[4] = {'C', 'M', 'M', 'I'};
+const uint32_t VERSION = 1;
+
+enum Tag : uint8_t {
+    TAG_FRAME = 0,
+    TAG_KEY,
+    TAG_BUTTON,
+    TAG_CURSOR,
+    TAG_SCROLL,
+};
+
+template<class T>
+void put(std::ofstream &out, T value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<class T>
+bool get(std::ifstream &in, T &value) {
+    return (bool)in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+} // namespace
+
+bool InputRecorder::open(const std::string &path, float timeStep) {
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write(MAGIC, sizeof(MAGIC));
+    put(out, VERSION);
+    put(out, timeStep);
+    frames = 0;
+    return (bool)out;
+}
+
+void InputRecorder::close() {
+    if (out.is_open())
+        out.close();
+}
+
+void InputRecorder::event(const InputEvent &e, float time) {
+    switch (e.type) {
+    case InputEvent::KEY:
+        put(out, (uint8_t)TAG_KEY);
+        put(out, time);
+        put(out, (int16_t)e.button);
+        put(out, (uint8_t)e.action);
+        put(out, (uint8_t)e.mods);
+        break;
+    case InputEvent::MOUSE_BUTTON:
+        put(out, (uint8_t)TAG_BUTTON);
+        put(out, time);
+        put(out, (uint8_t)e.button);
+        put(out, (uint8_t)e.action);
+        put(out, (uint8_t)e.mods);
+        put(out, (float)e.x);
+        put(out, (float)e.y);
+        break;
+    case InputEvent::CURSOR:
+        put(out, (uint8_t)TAG_CURSOR);
+        put(out, time);
+        put(out, (float)e.x);
+        put(out, (float)e.y);
+        break;
+    case InputEvent::SCROLL:
+        put(out, (uint8_t)TAG_SCROLL);
+        put(out, time);
+        put(out, (float)e.x);
+        put(out, (float)e.y);
+        break;
+    }
+}
+
+void InputRecorder::frame(float dt) {
+    put(out, (uint8_t)TAG_FRAME);
+    put(out, dt);
+    frames++;
+}
+
+bool InputReplay::open(const std::string &path) {
+    in.open(path, std::ios::binary);
+    char magic[4];
+    uint32_t version;
+    if (!in || !in.read(magic, sizeof(magic)) || !get(in, version) || !get(in, recordedTimeStep)
+        || std::string(magic, 4) != std::string(MAGIC, 4) || version != VERSION) {
+        in.close();
+        return false;
+    }
+    frames = 0;
+    return true;
+}
+
+InputReplay::Record InputReplay::read(InputEvent &e, float &dt) {
+    uint8_t tag, action, mods;
+    float time, x, y;
+    if (!get(in, tag))
+        return END;
+
+    e = InputEvent();
+    switch (tag) {
+    case TAG_FRAME:
+        return get(in, dt) ? FRAME : END;
+    case TAG_KEY: {
+        int16_t key;
+        if (!get(in, time) || !get(in, key) || !get(in, action) || !get(in, mods))
+            return END;
+        e.type = InputEvent::KEY;
+        e.button = key;
+        e.action = action;
+        e.mods = mods;
+        return EVENT;
+    }
+    case TAG_BUTTON: {
+        uint8_t button;
+        if (!get(in, time) || !get(in, button) || !get(in, action) || !get(in, mods) || !get(in, x) || !get(in, y))
+            return END;
+        e.type = InputEvent::MOUSE_BUTTON;
+        e.button = button;
+        e.action = action;
+        e.mods = mods;
+        e.x = x;
+        e.y = y;
+        return EVENT;
+    }
+    case TAG_CURSOR:
+    case TAG_SCROLL:
+        if (!get(in, time) || !get(in, x) || !get(in, y))
+            return END;
+        e.type = (tag == TAG_CURSOR) ? InputEvent::CURSOR : InputEvent::SCROLL;
+        e.x = x;
+        e.y = y;
+        return EVENT;
+    default:
+        // corrupt file, stop here
+        return END;
+    }
+}
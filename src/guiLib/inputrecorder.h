@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "application.h"
+
+// Compact binary log of input events and frame times, so that a session can
+// be replayed frame by frame. The file starts with a header (magic "CMMI",
+// format version, simulation time step) followed by records, each starting
+// with a one byte tag:
+//
+//   FRAME  float dt                          one per advance()
+//   KEY    float t, int16 key, u8 action, u8 mods
+//   BUTTON float t, u8 button, u8 action, u8 mods, float x, float y
+//   CURSOR float t, float x, float y
+//   SCROLL float t, float dx, float dy
+//
+// Events are dispatched before the frame that follows them; t is the time
+// since recording started and only informative. Values are stored in host
+// byte order.
+class InputRecorder {
+public:
+    // returns false if the file cannot be written
+    bool open(const std::string &path, float timeStep);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+
+    void event(const InputEvent &e, float time);
+    void frame(float dt);
+
+    long numFrames() const { return frames; }
+
+private:
+    std::ofstream out;
+    long frames = 0;
+};
+
+class InputReplay {
+public:
+    // returns false if the file cannot be read or is not a recording
+    bool open(const std::string &path);
+    bool isOpen() const { return in.is_open(); }
+
+    // time step the recording was made with
+    float timeStep() const { return recordedTimeStep; }
+
+    // reads the events up to the next frame record, hands each to dispatch
+    // and returns that frame's dt in dt; false at the end of the recording
+    template<class F>
+    bool nextFrame(F dispatch, float &dt) {
+        InputEvent e;
+        while (true) {
+            switch (read(e, dt)) {
+            case EVENT: dispatch(e); break;
+            case FRAME: frames++; return true;
+            case END: return false;
+            }
+        }
+    }
+
+    long numFrames() const { return frames; }
+
+private:
+    enum Record { EVENT, FRAME, END };
+    Record read(InputEvent &e, float &dt);
+
+    std::ifstream in;
+    float recordedTimeStep = 0.f;
+    long frames = 0;
+};
@@ -0,0 +1,127 @@
+#include "offscreen.h"
+#include "glext.h"
+
+#include <stdexcept>
+#include <string>
+
+#ifdef CMM_OFFSCREEN
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+OffscreenContext::OffscreenContext(int width, int height) {
+    // the destructor does not run for a constructor that throws
+    try {
+        init(width, height);
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+OffscreenContext::~OffscreenContext() {
+    release();
+}
+
+void OffscreenContext::init(int width, int height) {
+    // prefer Mesa's surfaceless platform, it needs neither X11 nor DRM
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (dpy == EGL_NO_DISPLAY)
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (dpy == EGL_NO_DISPLAY)
+        throw std::runtime_error("Failed to get an EGL display");
+
+    EGLint major, minor;
+    if (!eglInitialize(dpy, &major, &minor))
+        throw std::runtime_error("Failed to initialize EGL");
+    display = dpy;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+        throw std::runtime_error("EGL does not support desktop OpenGL");
+
+    // we render into our own framebuffer, any config will do (the default
+    // would ask for window surfaces)
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+        throw std::runtime_error("No suitable EGL config found");
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT)
+        throw std::runtime_error("Failed to create an OpenGL 3.3 core EGL context");
+    context = ctx;
+
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx))
+        throw std::runtime_error("Failed to make the surfaceless EGL context current");
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        throw std::runtime_error("Failed to initialize GLAD");
+    loadGLExtensions((GLADloadproc)eglGetProcAddress);
+
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthStencilBuffer);
+    resize(width, height);
+}
+
+void OffscreenContext::release() {
+    // GL is only loaded once the buffers exist
+    if (fbo) {
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthStencilBuffer);
+        glDeleteFramebuffers(1, &fbo);
+    }
+    if (context) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+    if (display)
+        eglTerminate(display);
+    fbo = colorBuffer = depthStencilBuffer = 0;
+    context = display = nullptr;
+}
+
+void OffscreenContext::resize(int width, int height) {
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    // NanoVG needs a stencil buffer
+    glBindRenderbuffer(GL_RENDERBUFFER, depthStencilBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Offscreen framebuffer incomplete: " + std::to_string(status));
+    glViewport(0, 0, width, height);
+}
+
+#else
+
+OffscreenContext::OffscreenContext(int, int) {
+    throw std::runtime_error("Offscreen rendering not available, rebuild with CMM_BUILD_OFFSCREEN=ON");
+}
+
+OffscreenContext::~OffscreenContext() {
+}
+
+void OffscreenContext::resize(int, int) {
+}
+
+#endif
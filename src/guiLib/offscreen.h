@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// An OpenGL 3.3 core context without any window or display, rendering into a
+// framebuffer object. Uses a surfaceless EGL display (e.g. Mesa llvmpipe), so
+// it works on servers without X11, Wayland or a GPU. Only available when
+// built with CMM_BUILD_OFFSCREEN.
+class OffscreenContext {
+public:
+    // creates the context, loads GL and binds a width x height framebuffer;
+    // throws std::runtime_error on failure
+    OffscreenContext(int width, int height);
+    ~OffscreenContext();
+
+    OffscreenContext(const OffscreenContext &) = delete;
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+    void resize(int width, int height);
+
+    GLuint framebuffer() const { return fbo; }
+
+private:
+    void init(int width, int height);
+    // frees whatever init() got to, also after it threw
+    void release();
+
+    void *display = nullptr;
+    void *context = nullptr;
+    GLuint fbo = 0, colorBuffer = 0, depthStencilBuffer = 0;
+};
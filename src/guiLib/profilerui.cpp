@@ -0,0 +1,463 @@
+#include "profilerui.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <imgui.h>
+#include "imgui_multiplot.h"
+
+using namespace perf;
+
+namespace {
+
+ImU32 zoneColor(const char *name) {
+    size_t h = std::hash<std::string>()(name);
+    return ImColor::HSV((h % 360) / 360.f, 0.5f, 0.85f);
+}
+
+// e.g. 12.3M
+std::string formatCount(uint64_t n) {
+    char buffer[32];
+    if (n >= 10000000000ull)
+        snprintf(buffer, sizeof(buffer), "%.1fG", n * 1e-9);
+    else if (n >= 10000000)
+        snprintf(buffer, sizeof(buffer), "%.1fM", n * 1e-6);
+    else if (n >= 10000)
+        snprintf(buffer, sizeof(buffer), "%.1fk", n * 1e-3);
+    else
+        snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)n);
+    return buffer;
+}
+
+void drawTimeline(const FrameMarker &frame, const std::vector<std::string> &threadNames,
+                  const std::vector<std::vector<ZoneEvent>> &zones) {
+    using namespace ImGui;
+
+    if (frame.end <= frame.begin)
+        return;
+
+    ImDrawList *drawList = GetWindowDrawList();
+    const float laneLabel = CalcTextSize("simulation   ").x;
+    const float rowHeight = GetTextLineHeightWithSpacing();
+    const float width = std::max(GetContentRegionAvail().x - laneLabel, 50.f);
+    const double scale = width / (double)(frame.end - frame.begin);
+
+    for (size_t t = 0; t < zones.size() && t < threadNames.size(); ++t) {
+        if (zones[t].empty())
+            continue;
+        int depth = 0;
+        for (const auto &z : zones[t])
+            depth = std::max(depth, z.depth + 1);
+
+        ImVec2 origin = GetCursorScreenPos();
+        drawList->AddText(origin, GetColorU32(ImVec4(1, 1, 1, 1)), threadNames[t].c_str());
+        ImVec2 lane(origin.x + laneLabel, origin.y);
+
+        for (const auto &z : zones[t]) {
+            uint64_t b = std::max(z.begin, frame.begin), e = std::min(z.end, frame.end);
+            ImVec2 p0(lane.x + (float)((b - frame.begin) * scale), lane.y + z.depth * rowHeight);
+            ImVec2 p1(lane.x + (float)((e - frame.begin) * scale), p0.y + rowHeight - 1);
+            p1.x = std::max(p1.x, p0.x + 1);
+            drawList->AddRectFilled(p0, p1, zoneColor(z.name));
+            if (p1.x - p0.x > CalcTextSize(z.name).x + 4) {
+                drawList->PushClipRect(p0, p1, true);
+                drawList->AddText(ImVec2(p0.x + 2, p0.y), GetColorU32(ImVec4(0, 0, 0, 1)), z.name);
+                drawList->PopClipRect();
+            }
+            if (IsMouseHoveringRect(p0, p1)) {
+                std::string counters;
+                for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+                    if (z.counters[c])
+                        counters += std::string("\n") + hwCounterName(c) + ": " + formatCount(z.counters[c]);
+                SetTooltip("%s: %.3f ms%s", z.name, ticksToMs(z.end - z.begin), counters.c_str());
+            }
+        }
+        Dummy(ImVec2(laneLabel + width, depth * rowHeight));
+    }
+}
+
+// inclusive time and hardware counters per zone name and thread, longest
+// first
+void drawTotals(const FrameMarker &frame, const std::vector<std::string> &threadNames,
+                const std::vector<std::vector<ZoneEvent>> &zones) {
+    using namespace ImGui;
+
+    struct Total {
+        uint64_t ticks = 0;
+        uint64_t counters[NUM_HW_COUNTERS] = {};
+    };
+    std::map<std::pair<std::string, std::string>, Total> totals;
+    uint32_t counted = 0;
+    for (size_t t = 0; t < zones.size() && t < threadNames.size(); ++t) {
+        for (const auto &z : zones[t]) {
+            Total &total = totals[{threadNames[t], z.name}];
+            total.ticks += std::min(z.end, frame.end) - std::max(z.begin, frame.begin);
+            for (int c = 0; c < NUM_HW_COUNTERS; ++c) {
+                total.counters[c] += z.counters[c];
+                if (z.counters[c])
+                    counted |= 1u << c;
+            }
+        }
+    }
+
+    std::vector<std::pair<const Total *, const std::pair<std::string, std::string> *>> sorted;
+    for (const auto &entry : totals)
+        sorted.push_back({&entry.second, &entry.first});
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first->ticks > b.first->ticks; });
+
+    if (!counted) {
+        for (const auto &s : sorted)
+            Text("%8.3f ms  %-12s %s", ticksToMs(s.first->ticks), s.second->first.c_str(), s.second->second.c_str());
+        return;
+    }
+
+    // counters next to wall time; IPC where both cycles and instructions count
+    const bool ipc = (counted & (1u << CYCLES)) && (counted & (1u << INSTRUCTIONS));
+    int columns = 2 + ipc;
+    for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+        columns += (counted >> c) & 1;
+    if (!BeginTable("totals", columns, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        return;
+    TableSetupColumn("zone");
+    TableSetupColumn("ms");
+    for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+        if (counted & (1u << c))
+            TableSetupColumn(hwCounterName(c));
+    if (ipc)
+        TableSetupColumn("IPC");
+    TableHeadersRow();
+    for (const auto &s : sorted) {
+        TableNextRow();
+        TableNextColumn();
+        Text("%s %s", s.second->first.c_str(), s.second->second.c_str());
+        TableNextColumn();
+        Text("%.3f", ticksToMs(s.first->ticks));
+        for (int c = 0; c < NUM_HW_COUNTERS; ++c) {
+            if (!(counted & (1u << c)))
+                continue;
+            TableNextColumn();
+            Text("%s", formatCount(s.first->counters[c]).c_str());
+        }
+        if (ipc) {
+            TableNextColumn();
+            if (s.first->counters[CYCLES])
+                Text("%.2f", (double)s.first->counters[INSTRUCTIONS] / s.first->counters[CYCLES]);
+        }
+    }
+    EndTable();
+}
+
+// allocations by zone name, inclusive of nested zones
+void drawZoneAllocations(const std::vector<std::string> &threadNames, const std::vector<std::vector<ZoneEvent>> &zones) {
+    using namespace ImGui;
+
+    std::map<std::pair<std::string, std::string>, std::pair<uint64_t, uint64_t>> totals;
+    for (size_t t = 0; t < zones.size() && t < threadNames.size(); ++t) {
+        for (const auto &z : zones[t]) {
+            if (z.allocations == 0)
+                continue;
+            auto &total = totals[{threadNames[t], z.name}];
+            total.first += z.allocations;
+            total.second += z.allocatedBytes;
+        }
+    }
+
+    std::vector<std::pair<std::pair<uint64_t, uint64_t>, const std::pair<std::string, std::string> *>> sorted;
+    for (const auto &entry : totals)
+        sorted.push_back({entry.second, &entry.first});
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    for (const auto &s : sorted)
+        Text("%6llu %10llu B  %-12s %s", (unsigned long long)s.first.first, (unsigned long long)s.first.second,
+             s.second->first.c_str(), s.second->second.c_str());
+}
+
+// the first caller of operator new outside the standard library
+std::string callSite(const AllocSample &sample) {
+    bool inNew = false;
+    std::string fallback;
+    for (int i = 0; i < sample.depth; ++i) {
+        std::string name = describeAddress(sample.frames[i]);
+        if (name.compare(0, 12, "operator new") == 0) {
+            inNew = true;
+            continue;
+        }
+        if (!inNew)
+            continue;
+        if (fallback.empty())
+            fallback = name;
+        if (name.compare(0, 5, "std::") != 0 && name.compare(0, 11, "__gnu_cxx::") != 0)
+            return name;
+    }
+    return fallback.empty() ? "?" : fallback;
+}
+
+float plotGetter(const void *data, int idx) {
+    return static_cast<const float *>(data)[idx];
+}
+
+} // namespace
+
+void ProfilerWindow::update(int offset) {
+    std::vector<FrameMarker> frames = Profiler::instance().frames();
+    if (frames.empty())
+        return;
+    int index = std::max(0, (int)frames.size() - 1 + offset);
+    frame = frames[index];
+    Profiler::instance().collect(frame.begin, frame.end, zones);
+    threadNames = Profiler::instance().threadNames();
+}
+
+void ProfilerWindow::draw(bool *open) {
+    using namespace ImGui;
+
+    if (!Begin("profiler", open)) {
+        End();
+        return;
+    }
+
+    bool enabled = Profiler::instance().enabled;
+    if (Checkbox("record", &enabled))
+        Profiler::instance().enabled = enabled;
+    SameLine();
+    // threads open their counters on their first zone with counters on
+    bool counters = Profiler::instance().hwCounters;
+    if (Checkbox("hw counters", &counters))
+        Profiler::instance().hwCounters = counters;
+    if (counters && IsItemHovered()) {
+        std::string available;
+        for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+            if (hwCounterMask() & (1u << c))
+                available += std::string(available.empty() ? "" : ", ") + hwCounterName(c);
+        SetTooltip("available: %s", available.empty() ? "none" : available.c_str());
+    }
+    SameLine();
+    Checkbox("pause", &paused);
+    if (paused) {
+        SameLine();
+        if (SliderInt("frame", &frameOffset, -(Profiler::FRAMES - 2), 0))
+            update(frameOffset);
+    } else {
+        // a few frames back, so the GPU lane is complete (see GpuTimer)
+        frameOffset = -LIVE_DELAY;
+        update(frameOffset);
+    }
+
+    Text("frame %ld: %.3f ms", frame.index, ticksToMs(frame.end - frame.begin));
+    drawTimeline(frame, threadNames, zones);
+    Separator();
+    drawTotals(frame, threadNames, zones);
+
+    End();
+}
+
+void FrameStatsWindow::draw(bool *open, FrameStats &stats) {
+    using namespace ImGui;
+
+    if (!Begin("frame stats", open)) {
+        End();
+        return;
+    }
+
+    Text("%-8s %8s %8s %8s %8s", "ms", "p50", "p95", "p99", "max");
+    for (int c = 0; c < FrameStats::NUM_CHANNELS; ++c) {
+        Quantiles q = stats.quantiles(c);
+        Text("%-8s %8.2f %8.2f %8.2f %8.2f", FrameStats::channelName(c), q.p50, q.p95, q.p99, q.max);
+    }
+
+    // the max per pixel column, so single slow frames stay visible
+    static const int PLOT_WIDTH = 200;
+    static float history[FrameStats::WINDOW];
+    static float lines[FrameStats::NUM_CHANNELS][PLOT_WIDTH];
+    float lows[PLOT_WIDTH];
+    int n = 0;
+    for (int c = 0; c < FrameStats::NUM_CHANNELS; ++c) {
+        n = stats.history(c, history);
+        if (n > 0)
+            decimateMinMax(history, n, PLOT_WIDTH, lows, lines[c]);
+    }
+    if (n > 0) {
+        const char *names[FrameStats::NUM_CHANNELS];
+        ImColor colors[FrameStats::NUM_CHANNELS] = {ImColor(220, 220, 220), ImColor(80, 180, 250), ImColor(250, 150, 60)};
+        for (int c = 0; c < FrameStats::NUM_CHANNELS; ++c)
+            names[c] = FrameStats::channelName(c);
+        float top = std::max(stats.quantiles(FrameStats::FRAME).max * 1.1f, 1.f);
+        PlotMultiLines("##times", FrameStats::NUM_CHANNELS, names, colors, &plotGetter, sizeof(lines[0]),
+                       (const void *const *)lines, PLOT_WIDTH, PLOT_WIDTH, 0, 0.f, top,
+                       ImVec2(GetContentRegionAvail().x, 120));
+    }
+
+    Separator();
+    Checkbox("capture spikes", &stats.captureSpikes);
+    SameLine();
+    InputFloat("threshold (ms)", &stats.spikeThreshold, 0.f, 0.f, "%.1f");
+    if (Button("clear"))
+        stats.clear();
+
+    const auto &spikes = stats.spikes();
+    if (selectedSpike >= (int)spikes.size())
+        selectedSpike = -1;
+    for (int i = (int)spikes.size() - 1; i >= 0; --i) {
+        char label[64];
+        snprintf(label, sizeof(label), "frame %ld: %.2f ms", spikes[i].frame.index, spikes[i].ms);
+        if (Selectable(label, selectedSpike == i))
+            selectedSpike = (selectedSpike == i) ? -1 : i;
+    }
+    if (selectedSpike >= 0) {
+        const FrameStats::Spike &spike = spikes[selectedSpike];
+        Separator();
+        drawTimeline(spike.frame, spike.threadNames, spike.zones);
+        Separator();
+        drawTotals(spike.frame, spike.threadNames, spike.zones);
+    }
+
+    End();
+}
+
+void AllocationsWindow::draw(bool *open, const AllocCounters &frame) {
+    using namespace ImGui;
+
+    if (!Begin("allocations", open)) {
+        End();
+        return;
+    }
+    if (!allocationTracking()) {
+        TextWrapped("Allocations are not counted, configure with -DCMM_TRACK_ALLOCATIONS=ON.");
+        End();
+        return;
+    }
+
+    history[next] = (float)frame.allocations;
+    next = (next + 1) % HISTORY;
+    AllocCounters total = totalAllocations();
+    Text("last frame: %llu allocations, %llu bytes, %llu frees", (unsigned long long)frame.allocations,
+         (unsigned long long)frame.bytes, (unsigned long long)frame.frees);
+    Text("total: %llu allocations, %llu live", (unsigned long long)total.allocations,
+         (unsigned long long)(total.allocations - total.frees));
+    float top = std::max(*std::max_element(history, history + HISTORY) * 1.1f, 1.f);
+    PlotLines("##allocations", history, HISTORY, next, "per frame", 0.f, top, ImVec2(GetContentRegionAvail().x, 60));
+
+    // zones of the latest frame, the profiler records their allocations
+    if (CollapsingHeader("zones of the latest frame", ImGuiTreeNodeFlags_DefaultOpen)) {
+        std::vector<FrameMarker> frames = Profiler::instance().frames(1);
+        if (!frames.empty()) {
+            std::vector<std::vector<ZoneEvent>> zones;
+            Profiler::instance().collect(frames.back().begin, frames.back().end, zones);
+            drawZoneAllocations(Profiler::instance().threadNames(), zones);
+        }
+    }
+
+    if (CollapsingHeader("call sites")) {
+        if (InputInt("sample every", &sampleEvery)) {
+            sampleEvery = std::max(sampleEvery, 0);
+            setAllocationSampling((unsigned int)sampleEvery);
+        }
+        std::map<std::string, std::pair<int, uint64_t>> sites;
+        for (const AllocSample &sample : allocationSamples()) {
+            auto &site = sites[callSite(sample)];
+            site.first++;
+            site.second += sample.size;
+        }
+        std::vector<std::pair<std::pair<int, uint64_t>, const std::string *>> sorted;
+        for (const auto &entry : sites)
+            sorted.push_back({entry.second, &entry.first});
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+        for (const auto &s : sorted)
+            Text("%4d %10llu B  %s", s.first.first, (unsigned long long)s.first.second, s.second->c_str());
+    }
+
+    End();
+}
+
+void CountersWindow::draw(bool *open, const FrameStats &stats) {
+    using namespace ImGui;
+
+    if (!Begin("counters", open)) {
+        End();
+        return;
+    }
+
+    Counters &counters = Counters::instance();
+    const int numCounters = counters.count();
+    static float history[Counters::MAX_COUNTERS][Counters::WINDOW];
+    int n = (numCounters > 0) ? Counters::WINDOW : 0;
+    for (int c = 0; c < numCounters; ++c)
+        n = std::min(n, counters.history(c, history[c]));
+
+    if (BeginTable("counters", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        TableSetupColumn("counter");
+        TableSetupColumn("latest");
+        TableSetupColumn("mean");
+        TableSetupColumn("max");
+        TableSetupColumn("plot");
+        TableHeadersRow();
+        for (int c = 0; c < numCounters; ++c) {
+            float sum = 0.f, hi = 0.f;
+            for (int i = 0; i < n; ++i) {
+                sum += history[c][i];
+                hi = std::max(hi, history[c][i]);
+            }
+            TableNextRow();
+            TableNextColumn();
+            Text("%s", counters.name(c).c_str());
+            TableNextColumn();
+            Text("%.0f", (n > 0) ? history[c][n - 1] : 0.f);
+            TableNextColumn();
+            Text("%.1f", (n > 0) ? sum / n : 0.f);
+            TableNextColumn();
+            Text("%.0f", hi);
+            TableNextColumn();
+            PushID(c);
+            Checkbox("##plot", &plotted[c]);
+            PopID();
+        }
+        EndTable();
+    }
+
+    // frame time and the chosen counters over the last n frames, the max per
+    // pixel column and scaled to [0, 1]
+    static const int PLOT_WIDTH = 200;
+    static float frameTimes[FrameStats::WINDOW];
+    static float lines[Counters::MAX_COUNTERS + 1][PLOT_WIDTH];
+    static std::string labels[Counters::MAX_COUNTERS + 1];
+    const char *names[Counters::MAX_COUNTERS + 1];
+    ImColor colors[Counters::MAX_COUNTERS + 1];
+    float lows[PLOT_WIDTH];
+    const int statsSize = stats.history(FrameStats::FRAME, frameTimes);
+    const int frames = std::min(n, statsSize);
+    int numLines = 0;
+    auto addLine = [&](const float *values, const std::string &name, ImColor color) {
+        float hi = std::max(*std::max_element(values, values + frames), 1e-6f);
+        decimateMinMax(values, frames, PLOT_WIDTH, lows, lines[numLines]);
+        for (float &v : lines[numLines])
+            v /= hi;
+        char max[32];
+        snprintf(max, sizeof(max), " (max %.4g)", hi);
+        labels[numLines] = name + max;
+        names[numLines] = labels[numLines].c_str();
+        colors[numLines] = color;
+        numLines++;
+    };
+    if (frames > 0) {
+        addLine(frameTimes + statsSize - frames, "frame ms", ImColor(220, 220, 220));
+        for (int c = 0; c < numCounters; ++c)
+            if (plotted[c])
+                addLine(history[c] + n - frames, counters.name(c), zoneColor(counters.name(c).c_str()));
+        PlotMultiLines("##counters", numLines, names, colors, &plotGetter, sizeof(lines[0]),
+                       (const void *const *)lines, PLOT_WIDTH, PLOT_WIDTH, 0, 0.f, 1.f,
+                       ImVec2(GetContentRegionAvail().x, 120));
+    }
+
+    Separator();
+    InputText("##csv", csvPath, sizeof(csvPath));
+    SameLine();
+    if (Button("save csv"))
+        status = counters.writeCsv(csvPath) ? std::string("saved ") + csvPath : std::string("failed to write ") + csvPath;
+    if (!status.empty())
+        Text("%s", status.c_str());
+
+    End();
+}
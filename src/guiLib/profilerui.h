@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <alloctracker.h>
+#include <counters.h>
+#include <framestats.h>
+#include <profiler.h>
+
+// ImGui window with the zones of one frame on a timeline: one lane per
+// thread, nested zones stacked below their parent, and the total time per
+// zone name. Shows one of the latest frames unless paused.
+class ProfilerWindow {
+public:
+    void draw(bool *open);
+
+private:
+    static const int LIVE_DELAY = 4;
+
+    void update(int frameOffset);
+
+    bool paused = false;
+    int frameOffset = 0; // 0 is the latest frame, -1 the one before...
+    perf::FrameMarker frame;
+    std::vector<std::string> threadNames;
+    std::vector<std::vector<perf::ZoneEvent>> zones;
+};
+
+// ImGui window with frame, process and draw time quantiles, their plot over
+// the rolling window and the timelines of captured spikes.
+class FrameStatsWindow {
+public:
+    void draw(bool *open, perf::FrameStats &stats);
+
+private:
+    int selectedSpike = -1;
+};
+
+// ImGui window with the heap allocations per frame, per zone of the latest
+// frame and the most frequent call sites of sampled allocations. Needs a
+// CMM_TRACK_ALLOCATIONS build.
+class AllocationsWindow {
+public:
+    void draw(bool *open, const perf::AllocCounters &frame);
+
+private:
+    static const int HISTORY = 240;
+
+    float history[HISTORY] = {};
+    int next = 0;
+    int sampleEvery = 0;
+};
+
+// ImGui window with the workload counters (see counters.h): the latest,
+// mean and max per frame, a plot of chosen counters against frame time, each
+// scaled to its own maximum, and a CSV export of the window.
+class CountersWindow {
+public:
+    void draw(bool *open, const perf::FrameStats &stats);
+
+private:
+    bool plotted[perf::Counters::MAX_COUNTERS] = {};
+    char csvPath[256] = "counters.csv";
+    std::string status;
+};
@@ -1,7 +1,53 @@
 #include "shader.h"
 
+#include "glext.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <profiler.h>
+
+// where linked programs are cached, see Shader::binaryCacheFolder
+#ifdef SHADER_CACHE_FOLDER
+std::string Shader::binaryCacheFolder = SHADER_CACHE_FOLDER;
+#else
+std::string Shader::binaryCacheFolder;
+#endif
+Shader::BuildStats Shader::buildStats;
+
+namespace
+{
+
+// header of a cached program binary
+struct BinaryHeader
+{
+    char magic[4];
+    uint32_t format;
+    uint32_t length;
+};
+
+const char BINARY_MAGIC[4] = {'C', 'M', 'M', 'B'};
+
+// samplers of any kind, all of them set with glUniform1i()
+bool isSamplerType(GLenum type)
+{
+    return (type >= GL_SAMPLER_1D && type <= GL_SAMPLER_2D_RECT_SHADOW) ||              // float
+           (type >= GL_SAMPLER_1D_ARRAY && type <= GL_SAMPLER_CUBE_SHADOW) ||           // float arrays, buffers
+           (type >= GL_INT_SAMPLER_1D && type <= GL_UNSIGNED_INT_SAMPLER_BUFFER) ||     // integer
+           (type >= GL_SAMPLER_2D_MULTISAMPLE && type <= GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY) ||
+           (type >= GL_SAMPLER_CUBE_MAP_ARRAY && type <= GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY);
+}
+
+} // namespace
+
 Shader::Shader(const char *vertexPath, const char *fragmentPath)
 {
+    PROFILE_ZONE("shader build");
+    auto start = std::chrono::steady_clock::now();
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
     std::string fragmentCode;
@@ -30,30 +76,129 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
-    const char* vShaderCode = vertexCode.c_str();
-    const char * fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
-    // vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    // fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, nullptr);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    // shader Program
     ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    // delete the shaders as they're linked into our program now and no longer necessery
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    // 2. load the linked program from the binary cache, if this driver cached it before
+    std::string cachePath = binaryCachePath(vertexCode, fragmentCode);
+    fromBinaryCache = !cachePath.empty() && loadBinary(cachePath);
+    if (!fromBinaryCache)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // 3. compile shaders
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, nullptr);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, nullptr);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // shader Program
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if (!cachePath.empty())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if (!cachePath.empty())
+            saveBinary(cachePath);
+    }
+    introspectUniforms();
 
+    buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (fromBinaryCache)
+    {
+        buildStats.cached++;
+        buildStats.cachedTime += buildTime;
+    }
+    else
+    {
+        buildStats.compiled++;
+        buildStats.compiledTime += buildTime;
+    }
+}
+
+std::string Shader::binaryCachePath(const std::string &vertexCode, const std::string &fragmentCode) const
+{
+    if (binaryCacheFolder.empty() || !glGetProgramBinary || !glProgramBinary || !glProgramParameteri)
+        return "";
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return "";
+
+    // FNV-1a of the sources and the driver, binaries only load into the driver that wrote them
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const char *data)
+    {
+        for (const char *c = data ? data : ""; ; ++c)
+        {
+            hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+            if (!*c)
+                break;
+        }
+    };
+    add(vertexCode.c_str());
+    add(fragmentCode.c_str());
+    add((const char *)glGetString(GL_VENDOR));
+    add((const char *)glGetString(GL_RENDERER));
+    add((const char *)glGetString(GL_VERSION));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return binaryCacheFolder + "/" + name;
+}
+
+bool Shader::loadBinary(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    BinaryHeader header;
+    if (!file.read((char *)&header, sizeof(header)) || std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+        return false;
+    std::vector<char> binary(header.length);
+    if (header.length == 0 || !file.read(binary.data(), header.length))
+        return false;
+    glProgramBinary(ID, header.format, binary.data(), (GLsizei)header.length);
+    // drivers reject binaries after an update, then we compile
+    GLint success = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    return success;
+}
+
+void Shader::saveBinary(const std::string &path) const
+{
+    GLint success = 0, length = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0)
+        return;
+    BinaryHeader header;
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, &length, &format, binary.data());
+    header.format = format;
+    header.length = (uint32_t)length;
+
+    // write a temporary file and rename it, so that no one reads half a binary
+    std::error_code error;
+    std::filesystem::create_directories(binaryCacheFolder, error);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write((const char *)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+            return;
+    }
+    std::filesystem::rename(temporary, path, error);
 }
 
 void Shader::use() const
@@ -61,64 +206,188 @@ void Shader::use() const
     glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string &name, bool value) const
+void Shader::setBool(UniformName name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(location(name), (int)value);
 }
 
-void Shader::setInt(const std::string &name, int value) const
+void Shader::setInt(UniformName name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(location(name), value);
 }
 
-void Shader::setFloat(const std::string &name, float value) const
+void Shader::setFloat(UniformName name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(location(name), value);
 }
 
-void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
+void Shader::setVec2(UniformName name, const glm::vec2 &value) const
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(location(name), 1, &value[0]);
 }
 
-void Shader::setVec2(const std::string &name, float x, float y) const
+void Shader::setVec2(UniformName name, float x, float y) const
 {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2f(location(name), x, y);
 }
 
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
+void Shader::setVec3(UniformName name, const glm::vec3 &value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(location(name), 1, &value[0]);
 }
 
-void Shader::setVec3(const std::string &name, float x, float y, float z) const
+void Shader::setVec3(UniformName name, float x, float y, float z) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(location(name), x, y, z);
+}
+
+void Shader::setVec4(UniformName name, const glm::vec4 &value) const
+{
+    glUniform4fv(location(name), 1, &value[0]);
+}
+
+void Shader::setVec4(UniformName name, float x, float y, float z, float w) const
+{
+    glUniform4f(location(name), x, y, z, w);
+}
+
+void Shader::setMat2(UniformName name, const glm::mat2 &mat) const
+{
+    glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::setMat3(UniformName name, const glm::mat3 &mat) const
+{
+    glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::setMat4(UniformName name, const glm::mat4 &mat) const
+{
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::introspectUniforms()
+{
+    uniforms.clear();
+    GLint count = 0, maxLength = 0, maxBlockLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockLength);
+    std::vector<GLchar> buffer(std::max(maxLength, 1)), blockBuffer(std::max(maxBlockLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), nullptr, &size, &type, buffer.data());
+        GLint location = glGetUniformLocation(ID, buffer.data());
+        // members of uniform blocks have no location; they are kept to tell
+        // whoever sets them where they went
+        std::string block;
+        if (location < 0)
+        {
+            GLuint index = (GLuint)i;
+            GLint blockIndex = -1;
+            glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+            if (blockIndex < 0)
+                continue;
+            glGetActiveUniformBlockName(ID, (GLuint)blockIndex, (GLsizei)blockBuffer.size(), nullptr, blockBuffer.data());
+            block = blockBuffer.data();
+        }
+        std::string name = buffer.data();
+        uniforms.push_back({uniformHash(name.c_str()), location, type, name, block});
+        // arrays are listed as "a[0]", also find them as "a"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            name.resize(name.size() - 3);
+            uniforms.push_back({uniformHash(name.c_str()), location, type, name, block});
+        }
+    }
+    std::sort(uniforms.begin(), uniforms.end(), [](const UniformInfo &a, const UniformInfo &b) { return a.hash < b.hash; });
+
+    GLint blocks = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    for (GLint i = 0; i < blocks; i++)
+    {
+        glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)blockBuffer.size(), nullptr, blockBuffer.data());
+        glUniformBlockBinding(ID, (GLuint)i, uniformBlockBinding(blockBuffer.data()));
+    }
+}
+
+const Shader::UniformInfo *Shader::find(UniformName name) const
+{
+    auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name.hash,
+                               [](const UniformInfo &u, uint32_t hash) { return u.hash < hash; });
+    for (; it != uniforms.end() && it->hash == name.hash; ++it)
+        if (it->name == name.name)
+            return &*it;
+    return nullptr;
+}
+
+GLint Shader::location(UniformName name) const
+{
+    if (const UniformInfo *info = find(name))
+    {
+        if (!info->block.empty() && !info->warned)
+        {
+            std::cout << "WARNING::SHADER::UNIFORM_IN_BLOCK " << info->name << " is a member of the uniform block "
+                      << info->block << ", set it through a UniformBlock (see CameraBlock and LightBlock in shader.h)" << std::endl;
+            info->warned = true;
+        }
+        return info->location;
+    }
+    if (std::strchr(name.name, '['))
+        return glGetUniformLocation(ID, name.name);
+    return -1;
 }
 
-void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
+GLint Shader::location(UniformName name, GLenum type) const
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    const UniformInfo *info = find(name);
+    if (!info || !info->block.empty())
+        return location(name);
+    // ints also set booleans and samplers, anything but matrices sets booleans
+    bool matches = info->type == type;
+    if (type == GL_INT)
+        matches = matches || info->type == GL_BOOL || isSamplerType(info->type);
+    if (type == GL_FLOAT)
+        matches = matches || info->type == GL_BOOL;
+    if (!matches)
+        throw std::runtime_error("uniform " + info->name + " has a different type in the shader");
+    return info->location;
 }
 
-void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const
+GLuint uniformBlockBinding(const char *name)
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    static std::vector<std::string> names;
+    for (size_t i = 0; i < names.size(); i++)
+        if (names[i] == name)
+            return (GLuint)i;
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &maxBindings);
+    if ((GLint)names.size() >= maxBindings)
+        throw std::runtime_error(std::string("no uniform buffer binding left for block ") + name);
+    names.push_back(name);
+    return (GLuint)names.size() - 1;
 }
 
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
+UniformBlock::UniformBlock(const char *name, GLsizeiptr size)
+    : binding(uniformBlockBinding(name)), size(size)
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
 }
 
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
+UniformBlock::~UniformBlock()
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glDeleteBuffers(1, &buffer);
 }
 
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+void UniformBlock::update(const void *data, GLsizeiptr size, GLintptr offset)
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
 }
 
 void Shader::checkCompileErrors(GLuint shader, std::string type)
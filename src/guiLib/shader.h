@@ -3,34 +3,208 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <string>
+#include <type_traits>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// FNV-1a hash of a uniform name, constexpr so that names known at compile
+// time are hashed by the compiler
+constexpr uint32_t uniformHash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	for (; *name; ++name)
+		hash = (hash ^ (uint8_t)*name) * 16777619u;
+	return hash;
+}
+
+// A uniform name and its hash. Converts implicitly from string literals and
+// std::string, so the set functions below take either without building a
+// std::string.
+struct UniformName
+{
+	const char *name;
+	uint32_t hash;
+
+	constexpr UniformName(const char *name) : name(name), hash(uniformHash(name)) {}
+	constexpr UniformName(const char *name, uint32_t hash) : name(name), hash(hash) {}
+	UniformName(const std::string &name) : UniformName(name.c_str()) {}
+};
+
+// A string literal is hashed where the call is evaluated, which optimizing
+// compilers usually but not necessarily do at compile time. These are always
+// hashed by the compiler: constexpr UniformName variables, like the ones
+// below, and UNIFORM("name"), whose hash is a template argument.
+#define UNIFORM(name) UniformName(name, std::integral_constant<uint32_t, uniformHash(name)>::value)
+
+// the uniforms of the shaders in shaders/ outside of uniform blocks
+namespace uniforms
+{
+constexpr UniformName model("model");
+constexpr UniformName objectColor("objectColor");
+constexpr UniformName textureDiffuse1("texture_diffuse1");
+} // namespace uniforms
+
+inline void setUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void setUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void setUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void setUniform(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::mat2 &mat) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void setUniform(GLint location, const glm::mat3 &mat) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void setUniform(GLint location, const glm::mat4 &mat) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
+
+// GL type of a uniform set from a T
+template <typename T> GLenum uniformType();
+template <> inline GLenum uniformType<bool>() { return GL_BOOL; }
+template <> inline GLenum uniformType<int>() { return GL_INT; }
+template <> inline GLenum uniformType<float>() { return GL_FLOAT; }
+template <> inline GLenum uniformType<glm::vec2>() { return GL_FLOAT_VEC2; }
+template <> inline GLenum uniformType<glm::vec3>() { return GL_FLOAT_VEC3; }
+template <> inline GLenum uniformType<glm::vec4>() { return GL_FLOAT_VEC4; }
+template <> inline GLenum uniformType<glm::mat2>() { return GL_FLOAT_MAT2; }
+template <> inline GLenum uniformType<glm::mat3>() { return GL_FLOAT_MAT3; }
+template <> inline GLenum uniformType<glm::mat4>() { return GL_FLOAT_MAT4; }
+
+// Typed handle to a uniform, see Shader::uniform(). set() is a plain
+// glUniform*() call on the program in use; for a uniform the program does
+// not have (e.g. optimized out) it does nothing, like location -1 in GL.
+template <typename T>
+class Uniform
+{
+public:
+	Uniform() = default;
+	explicit Uniform(GLint location) : location(location) {}
+
+	void set(const T &value) const { setUniform(location, value); }
+	bool valid() const { return location >= 0; }
+
+	GLint location = -1;
+};
+
+// Binding point of the shared uniform block of that name, assigned on first
+// use. Shader binds every block its program declares to the binding point of
+// the block's name at link time.
+GLuint uniformBlockBinding(const char *name);
+
+// A uniform buffer for a uniform block shared by all shaders, e.g. the camera:
+// updated once per frame and bound to the binding point of the block, so every
+// program declaring the block reads it without setting uniforms per program.
+class UniformBlock
+{
+public:
+	// name as declared in GLSL, size of the block in bytes (std140 layout)
+	UniformBlock(const char *name, GLsizeiptr size);
+	~UniformBlock();
+
+	UniformBlock(const UniformBlock &) = delete;
+	UniformBlock &operator=(const UniformBlock &) = delete;
+
+	void update(const void *data, GLsizeiptr size, GLintptr offset = 0);
+	template <typename T>
+	void update(const T &data) { update(&data, sizeof(T)); }
+
+	GLuint buffer = 0;
+	GLuint binding = 0;
+	GLsizeiptr size = 0;
+};
+
+// The blocks of the shaders in shaders/, in std140 layout (vec3 take the
+// space of a vec4)
+struct CameraBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos;
+	float pad0;
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock does not match the std140 layout of the Camera block");
+
+struct LightBlock
+{
+	glm::vec3 lightPos;
+	float pad0;
+	glm::vec3 lightColor;
+	float pad1;
+};
+static_assert(sizeof(LightBlock) == 32, "LightBlock does not match the std140 layout of the Light block");
+
 class Shader
 {
 public:
 	unsigned int ID;
-	// constructor generates the shader on the fly
+	// constructor generates the shader on the fly, or loads the linked program
+	// from the binary cache if this driver built it before
 	Shader(const char* vertexPath, const char* fragmentPath);
+
+	// folder of the program binary cache (GL 4.1 or ARB_get_program_binary);
+	// binaries are keyed by the sources and the driver. Defaults to the
+	// build folder, empty turns the cache off
+	static std::string binaryCacheFolder;
+	// time to read, build and introspect this shader, in ms
+	double buildTime = 0;
+	bool fromBinaryCache = false;
+	// totals of all shaders, to compare cold and warm startups
+	struct BuildStats
+	{
+		int compiled = 0, cached = 0;
+		double compiledTime = 0, cachedTime = 0; // ms
+	};
+	static BuildStats buildStats;
+
 	// activate the shader
 	void use() const;
+	// location of a uniform from the table of active uniforms built at link
+	// time, -1 if there is none of that name; array elements ("a[2]") are
+	// asked from GL. Members of uniform blocks are -1 too, with a warning the
+	// first time, since they need a UniformBlock
+	GLint location(UniformName name) const;
+	// typed handle to a uniform to set it without lookups, e.g.
+	// Uniform<glm::mat4> model = shader.uniform<glm::mat4>("model");
+	// throws std::runtime_error if the program declares it with another type
+	template <typename T>
+	Uniform<T> uniform(UniformName name) const { return Uniform<T>(location(name, uniformType<T>())); }
 	// utility uniform functions
-	void setBool(const std::string &name, bool value) const;
-	void setInt(const std::string &name, int value) const;
-	void setFloat(const std::string &name, float value) const;
-	void setVec2(const std::string &name, const glm::vec2 &value) const;
-	void setVec2(const std::string &name, float x, float y) const;
-	void setVec3(const std::string &name, const glm::vec3 &value) const;
-	void setVec3(const std::string &name, float x, float y, float z) const;
-	void setVec4(const std::string &name, const glm::vec4 &value) const;
-	void setVec4(const std::string &name, float x, float y, float z, float w) const;
-	void setMat2(const std::string &name, const glm::mat2 &mat) const;
-	void setMat3(const std::string &name, const glm::mat3 &mat) const;
-	void setMat4(const std::string &name, const glm::mat4 &mat) const;
+	void setBool(UniformName name, bool value) const;
+	void setInt(UniformName name, int value) const;
+	void setFloat(UniformName name, float value) const;
+	void setVec2(UniformName name, const glm::vec2 &value) const;
+	void setVec2(UniformName name, float x, float y) const;
+	void setVec3(UniformName name, const glm::vec3 &value) const;
+	void setVec3(UniformName name, float x, float y, float z) const;
+	void setVec4(UniformName name, const glm::vec4 &value) const;
+	void setVec4(UniformName name, float x, float y, float z, float w) const;
+	void setMat2(UniformName name, const glm::mat2 &mat) const;
+	void setMat3(UniformName name, const glm::mat3 &mat) const;
+	void setMat4(UniformName name, const glm::mat4 &mat) const;
 
 private:
+	struct UniformInfo
+	{
+		uint32_t hash;
+		GLint location;
+		GLenum type;
+		std::string name;
+		// the uniform block it is a member of (location -1), if any
+		std::string block;
+		mutable bool warned = false;
+	};
+	// active uniforms, sorted by hash
+	std::vector<UniformInfo> uniforms;
+
+	// fills uniforms from the linked program and binds its uniform blocks
+	void introspectUniforms();
+	const UniformInfo *find(UniformName name) const;
+	// location(name), checking the declared type against a GL type
+	GLint location(UniformName name, GLenum type) const;
+	// file of the program in the binary cache, empty if there is no cache
+	std::string binaryCachePath(const std::string &vertexCode, const std::string &fragmentCode) const;
+	bool loadBinary(const std::string &path);
+	void saveBinary(const std::string &path) const;
 	// utility function for checking shader compilation/linking errors.
 	void checkCompileErrors(GLuint shader, std::string type);
 };
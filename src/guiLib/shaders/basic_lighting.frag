@@ -4,9 +4,21 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
+// shared by all shaders, see CameraBlock in shader.h
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+// shared by all shaders, see LightBlock in shader.h
+layout (std140) uniform Light
+{
+    vec3 lightPos;
+    vec3 lightColor;
+};
+
 uniform vec3 objectColor;
 
 void main()
@@ -6,8 +6,14 @@ out vec3 FragPos;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// shared by all shaders, see CameraBlock in shader.h
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main()
 {
@@ -4,8 +4,14 @@ layout (location = 0) in vec3 aPos;
 out vec3 FragPos;
 
 //uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// shared by all shaders, see CameraBlock in shader.h
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main()
 {
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Lock-free bounded FIFO for one producer and one consumer thread. Neither
+// side ever blocks or allocates; push() fails when the queue is full. The
+// two indices live on separate cache lines so the threads do not fight over
+// them. Capacity must be a power of two.
+template<class T, size_t Capacity>
+class SPSCQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SPSCQueue() = default;
+    SPSCQueue(const SPSCQueue &) = delete;
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    // producer side
+    bool push(const T &value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache == Capacity) {
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache == Capacity)
+                return false;
+        }
+        items[t & MASK] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side; front() is only valid if !empty()
+    bool empty() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache)
+            tailCache = tail.load(std::memory_order_acquire);
+        return h == tailCache;
+    }
+
+    const T &front() const { return items[head.load(std::memory_order_relaxed) & MASK]; }
+
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    bool pop(T &value) {
+        if (empty())
+            return false;
+        value = front();
+        pop();
+        return true;
+    }
+
+private:
+    static const size_t MASK = Capacity - 1;
+
+    T items[Capacity];
+    // written by the consumer, with the producer's view of it
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tailCache = 0;
+    // written by the producer, with the consumer's view of it
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t headCache = 0;
+};
@@ -0,0 +1,180 @@
+#include "taskgraph.h"
+
+#include <algorithm>
+#include <string>
+
+#include <profiler.h>
+
+namespace {
+thread_local int currentWorker = -1;
+}
+
+bool TaskScheduler::Queue::pushBack(const Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == QUEUE_SIZE)
+        return false;
+    jobs[(head + count) % QUEUE_SIZE] = job;
+    count++;
+    return true;
+}
+
+bool TaskScheduler::Queue::popBack(Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+        return false;
+    count--;
+    job = jobs[(head + count) % QUEUE_SIZE];
+    return true;
+}
+
+bool TaskScheduler::Queue::popFront(Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+        return false;
+    job = jobs[head];
+    head = (head + 1) % QUEUE_SIZE;
+    count--;
+    return true;
+}
+
+TaskScheduler::TaskScheduler(int numWorkers) {
+    if (numWorkers <= 0)
+        numWorkers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for (int i = 0; i < numWorkers; ++i)
+        queues.emplace_back(new Queue());
+    for (int i = 0; i < numWorkers; ++i)
+        workers.emplace_back([this, i]() { workerLoop(i); });
+}
+
+TaskScheduler::~TaskScheduler() {
+    quit = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleeping.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+void TaskScheduler::submit(const Job &job) {
+    if (queues.empty()) {
+        job.fn(job.data);
+        return;
+    }
+
+    int q = (currentWorker >= 0) ? currentWorker : (int)(nextQueue++ % queues.size());
+    queued++;
+    if (!queues[q]->pushBack(job)) {
+        queued--;
+        job.fn(job.data);
+        return;
+    }
+    // a worker that counted itself as sleeping may not have blocked yet;
+    // taking the lock makes sure it sees the job or gets the notify
+    if (sleepers > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleeping.notify_one();
+}
+
+bool TaskScheduler::tryGet(int self, Job &job) {
+    if (queues[self]->popBack(job)) {
+        queued--;
+        return true;
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        if (queues[(self + i) % queues.size()]->popFront(job)) {
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::workerLoop(int index) {
+    currentWorker = index;
+    perf::setThreadName("worker " + std::to_string(index));
+    Job job;
+    while (!quit) {
+        if (tryGet(index, job)) {
+            job.fn(job.data);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers++;
+        sleeping.wait(lock, [this]() { return quit || queued > 0; });
+        sleepers--;
+    }
+}
+
+TaskGraph::TaskId TaskGraph::add(const char *name, std::function<void()> fn, bool mainThread) {
+    nodes.emplace_back();
+    Node &node = nodes.back();
+    node.graph = this;
+    node.name = name;
+    node.fn = std::move(fn);
+    node.mainThread = mainThread;
+    return (TaskId)nodes.size() - 1;
+}
+
+void TaskGraph::precede(TaskId before, TaskId after) {
+    nodes[before].successors.push_back(after);
+    nodes[after].numPredecessors++;
+}
+
+void TaskGraph::run(TaskScheduler &scheduler) {
+    this->scheduler = &scheduler;
+    mainQueue.reserve(nodes.size());
+    remaining = (int)nodes.size();
+    for (auto &node : nodes)
+        node.pending = node.numPredecessors;
+    for (auto &node : nodes)
+        if (node.numPredecessors == 0)
+            schedule(node);
+
+    // the end is only seen under mainMutex, after the last task released
+    // it, so the graph can be destroyed as soon as this returns
+    std::unique_lock<std::mutex> lock(mainMutex);
+    while (true) {
+        mainReady.wait(lock, [this]() { return !mainQueue.empty() || remaining == 0; });
+        if (mainQueue.empty())
+            break;
+        Node *node = mainQueue.back();
+        mainQueue.pop_back();
+        lock.unlock();
+        execute(node);
+        lock.lock();
+    }
+}
+
+void TaskGraph::execute(void *data) {
+    Node &node = *static_cast<Node *>(data);
+    TaskGraph &graph = *node.graph;
+
+    {
+        perf::Zone zone(node.name);
+        node.fn();
+    }
+
+    for (TaskId id : node.successors) {
+        Node &next = graph.nodes[id];
+        if (--next.pending == 0)
+            graph.schedule(next);
+    }
+    std::lock_guard<std::mutex> lock(graph.mainMutex);
+    if (--graph.remaining == 0)
+        graph.mainReady.notify_all();
+}
+
+void TaskGraph::schedule(Node &node) {
+    if (node.mainThread) {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainQueue.push_back(&node);
+        mainReady.notify_all();
+    } else {
+        Job job;
+        job.fn = &TaskGraph::execute;
+        job.data = &node;
+        scheduler->submit(job);
+    }
+}
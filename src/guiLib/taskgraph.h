@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work for the TaskScheduler: a function pointer and its argument,
+// so scheduling never allocates.
+struct Job {
+    void (*fn)(void *) = nullptr;
+    void *data = nullptr;
+};
+
+// A work-stealing thread pool. Every worker owns a bounded queue; it pops its
+// own jobs LIFO and, when that runs dry, steals FIFO from the others. Jobs
+// submitted from outside the pool are spread round robin.
+class TaskScheduler {
+public:
+    // 0 workers picks the hardware concurrency minus the calling thread
+    explicit TaskScheduler(int numWorkers = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler &) = delete;
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    int size() const { return (int)workers.size(); }
+
+    // queues a job; without workers, or with a full queue, it runs inline
+    void submit(const Job &job);
+
+private:
+    static const int QUEUE_SIZE = 1024;
+
+    struct Queue {
+        std::mutex mutex;
+        Job jobs[QUEUE_SIZE];
+        int head = 0, count = 0;
+
+        bool pushBack(const Job &job);
+        bool popBack(Job &job);
+        bool popFront(Job &job);
+    };
+
+    bool tryGet(int self, Job &job);
+    void workerLoop(int index);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned int> nextQueue{0};
+    std::atomic<bool> quit{false};
+    std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleeping;
+};
+
+// A static graph of tasks with dependencies, run once per frame. Tasks
+// marked mainThread are executed by the thread calling run() (e.g. for
+// GLFW and OpenGL), all others by the scheduler's workers. The calling
+// thread does not steal worker tasks, so it is always free for its own.
+class TaskGraph {
+public:
+    typedef int TaskId;
+
+    TaskId add(const char *name, std::function<void()> fn, bool mainThread = false);
+    // after only starts once before has finished
+    void precede(TaskId before, TaskId after);
+
+    // runs all tasks and returns once they are done
+    void run(TaskScheduler &scheduler);
+
+    const char *name(TaskId id) const { return nodes[id].name; }
+
+private:
+    struct Node {
+        TaskGraph *graph = nullptr;
+        const char *name = "";
+        std::function<void()> fn;
+        bool mainThread = false;
+        std::vector<TaskId> successors;
+        int numPredecessors = 0;
+        std::atomic<int> pending{0};
+    };
+
+    static void execute(void *node);
+    void schedule(Node &node);
+
+    std::deque<Node> nodes;
+    TaskScheduler *scheduler = nullptr;
+
+    // guarded by mainMutex
+    std::mutex mainMutex;
+    int remaining = 0;
+    std::condition_variable mainReady;
+    std::vector<Node *> mainQueue;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer handoff of the latest value.
+// The producer fills writeBuffer() and calls publish(); the consumer calls
+// update() and reads readBuffer(). Neither side ever waits: the producer
+// always has a buffer to write to and the consumer keeps the last published
+// one until a newer one is available. Intermediate values may be skipped.
+template<class T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // producer side
+    T &writeBuffer() { return buffers[writeIndex]; }
+
+    void publish() {
+        writeIndex = middle.exchange(writeIndex | DIRTY, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // consumer side; returns true if a new value was published since the
+    // last call
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & DIRTY))
+            return false;
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T &readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static const uint8_t INDEX = 0x3;
+    static const uint8_t DIRTY = 0x4;
+
+    T buffers[3];
+    uint8_t writeIndex = 0, readIndex = 1;
+    std::atomic<uint8_t> middle{2};
+};
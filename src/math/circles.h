@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Eigen/Core>
+
+namespace math {
+using Eigen::Vector2f;
+
+// A circle of the test app. The color type is up to the caller (NVGcolor in
+// the app), so that code without the GUI can use the same layout.
+template <typename Color>
+struct Circle {
+    Vector2f pos;
+    float radius;
+    Color colorFill, colorStroke;
+
+    bool isInside(const Vector2f &x) const {
+        return (x - pos).squaredNorm() <= radius * radius;
+    }
+};
+
+// moves circles kept as (velocity, circle) pairs by their velocity
+template <typename Container>
+void moveCircles(Container &circles, float dt) {
+    for (auto &c : circles)
+        c.second.pos += c.first * dt;
+}
+
+} // namespace math
@@ -0,0 +1,78 @@
+#include "parallel.h"
+
+#include <algorithm>
+
+namespace math {
+
+ThreadPool::ThreadPool(int numThreads) {
+    if (numThreads <= 0)
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int i = 1; i < numThreads; ++i)
+        workers.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+void ThreadPool::run(int n, int grainSize, Chunk chunk, const void *f) {
+    grainSize = std::max(1, grainSize);
+    if (n <= 0)
+        return;
+    if (workers.empty() || n <= grainSize) {
+        chunk(f, 0, n);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = chunk;
+        jobData = f;
+        jobSize = n;
+        jobGrain = grainSize;
+        nextIndex = 0;
+        busyWorkers = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return busyWorkers == 0; });
+    job = nullptr;
+    jobData = nullptr;
+}
+
+void ThreadPool::runChunks() {
+    int begin;
+    while ((begin = nextIndex.fetch_add(jobGrain)) < jobSize)
+        job(jobData, begin, std::min(begin + jobGrain, jobSize));
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+
+        runChunks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0)
+            done.notify_one();
+    }
+}
+
+} // namespace math
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace math {
+
+// A small pool of persistent worker threads for data-parallel loops. The
+// calling thread takes part in the work, so a pool of size 1 runs everything
+// inline without any synchronization.
+class ThreadPool {
+public:
+    // numThreads counts the calling thread; 0 picks the hardware concurrency.
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // Calls f(begin, end) on disjoint chunks of [0, n) of at most grainSize
+    // elements and returns once all chunks are done. Ranges that fit into a
+    // single chunk are run inline. f is called through a plain function
+    // pointer, so unlike std::function a capturing lambda never allocates.
+    template <typename F>
+    void parallelFor(int n, int grainSize, const F &f) {
+        run(n, grainSize, [](const void *f, int begin, int end) { (*(const F *)f)(begin, end); }, &f);
+    }
+
+private:
+    using Chunk = void (*)(const void *f, int begin, int end);
+
+    void run(int n, int grainSize, Chunk chunk, const void *f);
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    Chunk job = nullptr;
+    const void *jobData = nullptr;
+    int jobSize = 0, jobGrain = 1;
+    std::atomic<int> nextIndex{0};
+    int busyWorkers = 0;
+    uint64_t generation = 0;
+    bool quit = false;
+};
+
+} // namespace math
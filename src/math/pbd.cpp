@@ -0,0 +1,386 @@
+#include "pbd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace math {
+
+namespace {
+
+float cross(const Vector2f &a, const Vector2f &b) {
+    return a[0] * b[1] - a[1] * b[0];
+}
+
+float wrapAngle(float a) {
+    while (a > (float)M_PI)
+        a -= 2.f * (float)M_PI;
+    while (a <= -(float)M_PI)
+        a += 2.f * (float)M_PI;
+    return a;
+}
+
+float currentAngle(const std::vector<Particle> &particles, int i, int j, int k) {
+    Vector2f a = particles[i].pos - particles[j].pos;
+    Vector2f b = particles[k].pos - particles[j].pos;
+    return std::atan2(cross(a, b), a.dot(b));
+}
+
+unsigned int cellHash(int cx, int cy, int tableSize) {
+    unsigned int h = ((unsigned int)cx * 92837111u) ^ ((unsigned int)cy * 689287499u);
+    return h % (unsigned int)tableSize;
+}
+
+} // namespace
+
+void colorConstraints(const std::vector<Constraint> &constraints, int numParticles, ConstraintBatches &batches) {
+    ColoringBuffers buffers;
+    colorConstraints(constraints, numParticles, batches, buffers);
+}
+
+void colorConstraints(const std::vector<Constraint> &constraints, int numParticles, ConstraintBatches &batches,
+                      ColoringBuffers &buffers) {
+    const int maxColors = 64;
+    std::vector<uint64_t> &used = buffers.used;
+    std::vector<int> &color = buffers.color;
+    used.assign(numParticles, 0);
+    color.resize(constraints.size());
+    int count[maxColors + 1] = {};
+
+    for (size_t c = 0; c < constraints.size(); ++c) {
+        const Constraint &con = constraints[c];
+        uint64_t mask = 0;
+        for (int k = 0; k < con.numParticles(); ++k)
+            mask |= used[con.p[k]];
+
+        int col = maxColors; // overflow batch
+        if (~mask != 0) {
+            col = 0;
+            while (mask & (uint64_t(1) << col))
+                col++;
+            for (int k = 0; k < con.numParticles(); ++k)
+                used[con.p[k]] |= uint64_t(1) << col;
+        }
+        color[c] = col;
+        count[col]++;
+    }
+
+    // counting sort into contiguous batches, dropping empty colors
+    batches.offsets.assign(1, 0);
+    int start[maxColors + 1];
+    int offset = 0;
+    for (int col = 0; col <= maxColors; ++col) {
+        start[col] = offset;
+        if (count[col] > 0) {
+            offset += count[col];
+            batches.offsets.push_back(offset);
+        }
+    }
+    batches.serialLast = count[maxColors] > 0;
+
+    batches.constraints.resize(constraints.size());
+    for (size_t c = 0; c < constraints.size(); ++c)
+        batches.constraints[start[color[c]]++] = constraints[c];
+}
+
+PBDSolver::PBDSolver(int numThreads)
+    : pool(new ThreadPool(numThreads)) {
+}
+
+int PBDSolver::addParticle(const Vector2f &pos, float radius, float invMass, int group) {
+    Particle p;
+    p.pos = p.prevPos = pos;
+    p.radius = radius;
+    p.invMass = invMass;
+    p.group = group;
+    particles.push_back(p);
+    return (int)particles.size() - 1;
+}
+
+void PBDSolver::addDistanceConstraint(int i, int j, float compliance) {
+    Constraint c;
+    c.type = Constraint::DISTANCE;
+    c.p[0] = i;
+    c.p[1] = j;
+    c.rest = (particles[i].pos - particles[j].pos).norm();
+    c.compliance = compliance;
+    constraints.push_back(c);
+    batchesDirty = true;
+}
+
+void PBDSolver::addBendingConstraint(int i, int j, int k, float compliance) {
+    Constraint c;
+    c.type = Constraint::BENDING;
+    c.p[0] = i;
+    c.p[1] = j;
+    c.p[2] = k;
+    c.rest = currentAngle(particles, i, j, k);
+    c.compliance = compliance;
+    constraints.push_back(c);
+    batchesDirty = true;
+}
+
+void PBDSolver::setBounds(const Vector2f &min, const Vector2f &max) {
+    hasBounds = true;
+    boundsMin = min;
+    boundsMax = max;
+}
+
+int PBDSolver::addRope(const Vector2f &a, const Vector2f &b, int n, float radius, float compliance,
+                       float bendingCompliance, bool pinStart) {
+    n = std::max(n, 2);
+    int group = nextGroup++;
+    int first = (int)particles.size();
+    for (int i = 0; i < n; ++i)
+        addParticle(a + (b - a) * ((float)i / (n - 1)), radius, (pinStart && i == 0) ? 0.f : 1.f, group);
+    for (int i = first; i + 1 < first + n; ++i)
+        addDistanceConstraint(i, i + 1, compliance);
+    for (int i = first; i + 2 < first + n; ++i)
+        addBendingConstraint(i, i + 1, i + 2, bendingCompliance);
+    return first;
+}
+
+int PBDSolver::addSoftBody(const Vector2f &topLeft, int cols, int rows, float spacing, float radius,
+                           float compliance) {
+    int group = nextGroup++;
+    int first = (int)particles.size();
+    for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < cols; ++c)
+            addParticle(topLeft + Vector2f(c * spacing, r * spacing), radius, 1.f, group);
+
+    auto idx = [&](int c, int r) { return first + r * cols + c; };
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            if (c + 1 < cols)
+                addDistanceConstraint(idx(c, r), idx(c + 1, r), compliance);
+            if (r + 1 < rows)
+                addDistanceConstraint(idx(c, r), idx(c, r + 1), compliance);
+            if (c + 1 < cols && r + 1 < rows) {
+                addDistanceConstraint(idx(c, r), idx(c + 1, r + 1), compliance);
+                addDistanceConstraint(idx(c + 1, r), idx(c, r + 1), compliance);
+            }
+        }
+    }
+    return first;
+}
+
+int PBDSolver::addParticleRows(const Vector2f &topLeft, float width, int count, float radius) {
+    int first = (int)particles.size();
+    int perRow = std::max(1, (int)(width / (3 * radius)));
+    for (int i = 0; i < count; ++i)
+        addParticle(topLeft + Vector2f(2 * radius + (i % perRow) * 3 * radius, 2 * radius + (i / perRow) * 3 * radius),
+                    radius);
+    return first;
+}
+
+void PBDSolver::clear() {
+    particles.clear();
+    constraints.clear();
+    batches = ConstraintBatches();
+    contacts = ConstraintBatches();
+    batchesDirty = true;
+    nextGroup = 0;
+}
+
+void PBDSolver::step(float dt) {
+    if (particles.empty() || dt <= 0.f)
+        return;
+
+    if (batchesDirty) {
+        colorConstraints(constraints, (int)particles.size(), batches, coloring);
+        batchesDirty = false;
+    }
+
+    // contacts are found once per step; the margin covers the distance a
+    // particle can travel within the step
+    if (collisions) {
+        float maxSpeed = 0.f;
+        for (const auto &p : particles)
+            maxSpeed = std::max(maxSpeed, p.vel.norm());
+        findContacts((maxSpeed + gravity.norm() * dt) * dt);
+    }
+
+    const int n = (int)particles.size();
+    const float h = dt / std::max(substeps, 1);
+    const float keep = std::max(0.f, 1.f - damping * h);
+
+    for (int s = 0; s < std::max(substeps, 1); ++s) {
+        pool->parallelFor(n, 256, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                Particle &p = particles[i];
+                p.prevPos = p.pos;
+                if (p.invMass == 0.f)
+                    continue;
+                p.vel += gravity * h;
+                p.pos += p.vel * h;
+            }
+        });
+
+        for (auto &c : batches.constraints)
+            c.lambda = 0.f;
+        for (auto &c : contacts.constraints)
+            c.lambda = 0.f;
+
+        for (int it = 0; it < iterations; ++it) {
+            projectBatches(batches, h);
+            projectBatches(contacts, h);
+            if (hasBounds)
+                pool->parallelFor(n, 256, [this](int begin, int end) { projectBounds(begin, end); });
+        }
+
+        pool->parallelFor(n, 256, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                Particle &p = particles[i];
+                p.vel = (p.pos - p.prevPos) / h * keep;
+            }
+        });
+    }
+}
+
+float PBDSolver::maxDistanceError() const {
+    float err = 0.f;
+    for (const auto &c : batches.constraints)
+        if (c.type == Constraint::DISTANCE)
+            err = std::max(err, std::abs((particles[c.p[0]].pos - particles[c.p[1]].pos).norm() - c.rest));
+    return err;
+}
+
+void PBDSolver::findContacts(float margin) {
+    const int n = (int)particles.size();
+    float maxRadius = 0.f;
+    for (const auto &p : particles)
+        maxRadius = std::max(maxRadius, p.radius);
+    const float cellSize = 2.f * maxRadius + margin;
+    const int tableSize = 2 * n;
+
+    auto cellOf = [cellSize](const Vector2f &x, int &cx, int &cy) {
+        cx = (int)std::floor(x[0] / cellSize);
+        cy = (int)std::floor(x[1] / cellSize);
+    };
+
+    // counting sort of particles into hash buckets
+    cellStart.assign(tableSize + 1, 0);
+    cellEntries.resize(n);
+    hashes.resize(n);
+    for (int i = 0; i < n; ++i) {
+        int cx, cy;
+        cellOf(particles[i].pos, cx, cy);
+        hashes[i] = cellHash(cx, cy, tableSize);
+        cellStart[hashes[i]]++;
+    }
+    for (int h = 0, sum = 0; h <= tableSize; ++h) {
+        sum += cellStart[h];
+        cellStart[h] = sum;
+    }
+    for (int i = 0; i < n; ++i)
+        cellEntries[--cellStart[hashes[i]]] = i;
+
+    found.clear();
+    for (int i = 0; i < n; ++i) {
+        const Particle &pi = particles[i];
+        int cx, cy;
+        cellOf(pi.pos, cx, cy);
+
+        // neighbouring cells can share a bucket, visit each bucket once
+        unsigned int visited[9];
+        int numVisited = 0;
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                unsigned int h = cellHash(cx + dx, cy + dy, tableSize);
+                if (std::find(visited, visited + numVisited, h) != visited + numVisited)
+                    continue;
+                visited[numVisited++] = h;
+
+                for (int e = cellStart[h]; e < cellStart[h + 1]; ++e) {
+                    int j = cellEntries[e];
+                    if (j <= i)
+                        continue;
+                    const Particle &pj = particles[j];
+                    if (pi.group >= 0 && pi.group == pj.group)
+                        continue;
+                    if (pi.invMass == 0.f && pj.invMass == 0.f)
+                        continue;
+                    float rest = pi.radius + pj.radius;
+                    if ((pi.pos - pj.pos).squaredNorm() > (rest + margin) * (rest + margin))
+                        continue;
+
+                    Constraint c;
+                    c.type = Constraint::COLLISION;
+                    c.p[0] = i;
+                    c.p[1] = j;
+                    c.rest = rest;
+                    c.compliance = collisionCompliance;
+                    found.push_back(c);
+                }
+            }
+        }
+    }
+
+    colorConstraints(found, n, contacts, coloring);
+}
+
+void PBDSolver::projectBatches(ConstraintBatches &b, float dt) {
+    for (int batch = 0; batch < b.numBatches(); ++batch) {
+        int begin = b.offsets[batch], count = b.offsets[batch + 1] - begin;
+        if (b.serialLast && batch == b.numBatches() - 1) {
+            for (int c = begin; c < begin + count; ++c)
+                projectConstraint(b.constraints[c], dt);
+            continue;
+        }
+        pool->parallelFor(count, 128, [&](int cb, int ce) {
+            for (int c = begin + cb; c < begin + ce; ++c)
+                projectConstraint(b.constraints[c], dt);
+        });
+    }
+}
+
+void PBDSolver::projectConstraint(Constraint &c, float dt) {
+    Vector2f grad[3];
+    float C;
+
+    if (c.type == Constraint::BENDING) {
+        Vector2f a = particles[c.p[0]].pos - particles[c.p[1]].pos;
+        Vector2f b = particles[c.p[2]].pos - particles[c.p[1]].pos;
+        float la = a.squaredNorm(), lb = b.squaredNorm();
+        if (la < 1e-12f || lb < 1e-12f)
+            return;
+        C = wrapAngle(std::atan2(cross(a, b), a.dot(b)) - c.rest);
+        grad[0] = Vector2f(a[1], -a[0]) / la;
+        grad[2] = Vector2f(-b[1], b[0]) / lb;
+        grad[1] = -(grad[0] + grad[2]);
+    } else {
+        Vector2f d = particles[c.p[0]].pos - particles[c.p[1]].pos;
+        float len = d.norm();
+        if (len < 1e-6f)
+            return;
+        C = len - c.rest;
+        if (c.type == Constraint::COLLISION && C >= 0.f)
+            return;
+        grad[0] = d / len;
+        grad[1] = -grad[0];
+    }
+
+    const int np = c.numParticles();
+    float w = 0.f;
+    for (int k = 0; k < np; ++k)
+        w += particles[c.p[k]].invMass * grad[k].squaredNorm();
+    const float alpha = c.compliance / (dt * dt);
+    if (w + alpha < 1e-12f)
+        return;
+
+    const float dLambda = (-C - alpha * c.lambda) / (w + alpha);
+    c.lambda += dLambda;
+    for (int k = 0; k < np; ++k)
+        particles[c.p[k]].pos += particles[c.p[k]].invMass * dLambda * grad[k];
+}
+
+void PBDSolver::projectBounds(int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        Particle &p = particles[i];
+        if (p.invMass == 0.f)
+            continue;
+        for (int d = 0; d < 2; ++d)
+            p.pos[d] = std::max(boundsMin[d] + p.radius, std::min(boundsMax[d] - p.radius, p.pos[d]));
+    }
+}
+
+} // namespace math
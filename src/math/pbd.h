@@ -0,0 +1,139 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "parallel.h"
+
+namespace math {
+using Eigen::Vector2f;
+
+// A circular particle of the position-based dynamics solver.
+struct Particle {
+    Vector2f pos = Vector2f::Zero();
+    Vector2f prevPos = Vector2f::Zero();
+    Vector2f vel = Vector2f::Zero();
+    float radius = 1.f;
+    float invMass = 1.f; // 0 pins the particle in place
+    int group = -1;      // particles of the same group (>= 0) do not collide
+};
+
+// An XPBD constraint acting on up to three particles. compliance is the
+// inverse stiffness (0 is rigid), lambda the accumulated Lagrange multiplier.
+struct Constraint {
+    enum Type : uint8_t {
+        DISTANCE,  // |p0 - p1| = rest
+        BENDING,   // signed angle (p0 - p1, p2 - p1) = rest
+        COLLISION, // |p0 - p1| >= rest
+    };
+
+    Type type = DISTANCE;
+    int p[3] = {-1, -1, -1};
+    float rest = 0.f;
+    float compliance = 0.f;
+    float lambda = 0.f;
+
+    int numParticles() const { return (type == BENDING) ? 3 : 2; }
+};
+
+// Constraints grouped by graph coloring: no two constraints of the same batch
+// share a particle, so a batch can be projected in parallel without atomics.
+// The last batch holds constraints that did not fit into any color and is
+// projected serially.
+struct ConstraintBatches {
+    std::vector<Constraint> constraints;
+    std::vector<int> offsets = {0}; // batch b is [offsets[b], offsets[b+1])
+    bool serialLast = false;
+
+    int numBatches() const { return (int)offsets.size() - 1; }
+};
+
+// Scratch memory of colorConstraints, kept to recolor without allocating.
+struct ColoringBuffers {
+    std::vector<uint64_t> used;
+    std::vector<int> color;
+};
+
+// Greedy first-fit coloring of constraints over numParticles particles.
+void colorConstraints(const std::vector<Constraint> &constraints, int numParticles, ConstraintBatches &batches);
+void colorConstraints(const std::vector<Constraint> &constraints, int numParticles, ConstraintBatches &batches,
+                      ColoringBuffers &buffers);
+
+// Extended position-based dynamics (Macklin et al. 2016) with substepping
+// (Macklin et al. 2019). Units follow the caller, e.g. pixels and seconds.
+class PBDSolver {
+public:
+    std::vector<Particle> particles;
+
+    Vector2f gravity = {0.f, 981.f};
+    int substeps = 8;
+    int iterations = 1;
+    float damping = 0.1f; // fraction of velocity lost per second
+
+    // particles are kept inside [boundsMin, boundsMax] if hasBounds is set
+    bool hasBounds = false;
+    Vector2f boundsMin = Vector2f::Zero(), boundsMax = Vector2f::Zero();
+
+    bool collisions = true;
+    float collisionCompliance = 0.f;
+
+public:
+    // numThreads as in ThreadPool, 1 runs the solver single threaded
+    explicit PBDSolver(int numThreads = 0);
+
+    int addParticle(const Vector2f &pos, float radius, float invMass = 1.f, int group = -1);
+    void addDistanceConstraint(int i, int j, float compliance = 0.f);
+    void addBendingConstraint(int i, int j, int k, float compliance = 0.f);
+    void setBounds(const Vector2f &min, const Vector2f &max);
+
+    // A rope of n particles from a to b; returns the index of its first
+    // particle. Stiff ropes (small bending compliance) behave like chains.
+    int addRope(const Vector2f &a, const Vector2f &b, int n, float radius, float compliance = 0.f,
+                float bendingCompliance = 1e-2f, bool pinStart = true);
+
+    // A cols x rows lattice of particles with structural and shear springs;
+    // returns the index of its first particle.
+    int addSoftBody(const Vector2f &topLeft, int cols, int rows, float spacing, float radius,
+                    float compliance = 1e-5f);
+
+    // count loose particles in rows from topLeft, three radii apart and as
+    // many per row as fit into width; returns the index of the first
+    // particle. radius must be positive.
+    int addParticleRows(const Vector2f &topLeft, float width, int count, float radius);
+
+    void clear();
+
+    // advances the simulation by dt
+    void step(float dt);
+
+    int numConstraints() const { return (int)constraints.size(); }
+    int numContacts() const { return (int)contacts.constraints.size(); }
+    int numColors() const { return batches.numBatches(); }
+
+    // largest violation of a distance constraint after the last step
+    float maxDistanceError() const;
+
+private:
+    void findContacts(float margin);
+    void projectBatches(ConstraintBatches &b, float dt);
+    void projectConstraint(Constraint &c, float dt);
+    void projectBounds(int begin, int end);
+
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<Constraint> constraints;
+    ConstraintBatches batches, contacts;
+    bool batchesDirty = true;
+    int nextGroup = 0;
+
+    // spatial hash for the collision broad phase; these buffers are reused
+    // so that a step does not allocate once they have grown
+    std::vector<int> cellStart, cellEntries;
+    std::vector<unsigned int> hashes;
+    std::vector<Constraint> found;
+    ColoringBuffers coloring;
+};
+
+} // namespace math
@@ -0,0 +1,236 @@
+#include "alloctracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#define PERF_HAS_BACKTRACE
+#endif
+
+namespace perf {
+
+#ifdef CMM_TRACK_ALLOCATIONS
+
+namespace {
+
+// Counters of one thread on a cache line of their own, read by others at
+// any time. Threads beyond MAX_THREADS all share the last slot, which is
+// why even the owner only updates them atomically.
+struct alignas(64) Slot {
+    std::atomic<uint64_t> allocations{0}, bytes{0}, frees{0};
+};
+
+const int MAX_THREADS = 256;
+const int MAX_SAMPLES = 256;
+
+// plain arrays and trivially initialized thread locals: the hooks must not
+// allocate themselves
+Slot slots[MAX_THREADS];
+std::atomic<int> numSlots{0};
+thread_local Slot *threadSlot = nullptr;
+thread_local bool sampling = false;
+
+std::atomic<unsigned int> sampleEvery{0};
+AllocSample samples[MAX_SAMPLES];
+std::atomic<uint64_t> numSamples{0};
+
+Slot &slot() {
+    if (!threadSlot) {
+        int i = numSlots.fetch_add(1, std::memory_order_relaxed);
+        threadSlot = &slots[(i < MAX_THREADS) ? i : MAX_THREADS - 1];
+    }
+    return *threadSlot;
+}
+
+void sample(size_t size) {
+#ifdef PERF_HAS_BACKTRACE
+    // backtrace() allocates when it runs for the first time
+    if (sampling)
+        return;
+    sampling = true;
+    uint64_t n = numSamples.fetch_add(1, std::memory_order_relaxed);
+    AllocSample &s = samples[n % MAX_SAMPLES];
+    s.size = size;
+    s.depth = backtrace(s.frames, AllocSample::MAX_FRAMES);
+    sampling = false;
+#endif
+}
+
+void *allocate(size_t size, size_t alignment = 0) {
+    void *p = alignment ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                        : std::malloc(size ? size : 1);
+    Slot &s = slot();
+    uint64_t n = s.allocations.fetch_add(1, std::memory_order_relaxed) + 1;
+    s.bytes.fetch_add(size, std::memory_order_relaxed);
+    unsigned int every = sampleEvery.load(std::memory_order_relaxed);
+    if (every && n % every == 0)
+        sample(size);
+    return p;
+}
+
+void deallocate(void *p) {
+    if (!p)
+        return;
+    slot().frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+AllocCounters read(const Slot &s) {
+    AllocCounters c;
+    c.allocations = s.allocations.load(std::memory_order_relaxed);
+    c.bytes = s.bytes.load(std::memory_order_relaxed);
+    c.frees = s.frees.load(std::memory_order_relaxed);
+    return c;
+}
+
+} // namespace
+
+bool allocationTracking() {
+    return true;
+}
+
+AllocCounters threadAllocations() {
+    return read(slot());
+}
+
+AllocCounters totalAllocations() {
+    AllocCounters total;
+    int n = std::min(numSlots.load(std::memory_order_relaxed), MAX_THREADS);
+    for (int i = 0; i < n; ++i) {
+        AllocCounters c = read(slots[i]);
+        total.allocations += c.allocations;
+        total.bytes += c.bytes;
+        total.frees += c.frees;
+    }
+    return total;
+}
+
+void setAllocationSampling(unsigned int every) {
+    sampleEvery = every;
+}
+
+std::vector<AllocSample> allocationSamples() {
+    uint64_t n = numSamples.load(std::memory_order_relaxed);
+    uint64_t count = std::min<uint64_t>(n, MAX_SAMPLES);
+    std::vector<AllocSample> result;
+    for (uint64_t i = n - count; i < n; ++i)
+        result.push_back(samples[i % MAX_SAMPLES]);
+    return result;
+}
+
+#else
+
+bool allocationTracking() {
+    return false;
+}
+
+AllocCounters threadAllocations() {
+    return AllocCounters();
+}
+
+AllocCounters totalAllocations() {
+    return AllocCounters();
+}
+
+void setAllocationSampling(unsigned int) {
+}
+
+std::vector<AllocSample> allocationSamples() {
+    return std::vector<AllocSample>();
+}
+
+#endif
+
+std::string describeAddress(void *address) {
+#ifdef PERF_HAS_BACKTRACE
+    Dl_info info;
+    if (dladdr(address, &info) && info.dli_sname) {
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = (status == 0 && demangled) ? demangled : info.dli_sname;
+        std::free(demangled);
+        return name;
+    }
+#endif
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%p", address);
+    return buffer;
+}
+
+} // namespace perf
+
+#ifdef CMM_TRACK_ALLOCATIONS
+
+// replacements of the global allocation functions, see [new.delete]
+
+void *operator new(std::size_t size) {
+    if (void *p = perf::allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    if (void *p = perf::allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return perf::allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return perf::allocate(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    if (void *p = perf::allocate(size, (size_t)alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    if (void *p = perf::allocate(size, (size_t)alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete[](void *p) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    perf::deallocate(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    perf::deallocate(p);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace perf {
+
+// Heap allocations counted by the global operator new/delete replacements
+// of a CMM_TRACK_ALLOCATIONS build. Without it everything stays zero.
+struct AllocCounters {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0; // requested, frees are not subtracted
+    uint64_t frees = 0;
+
+    AllocCounters operator-(const AllocCounters &o) const {
+        return {allocations - o.allocations, bytes - o.bytes, frees - o.frees};
+    }
+};
+
+// whether the hooks are compiled in
+bool allocationTracking();
+
+// of the calling thread, since it started
+AllocCounters threadAllocations();
+// of all threads, since the program started
+AllocCounters totalAllocations();
+
+// A call stack captured at every n-th allocation.
+struct AllocSample {
+    static const int MAX_FRAMES = 12;
+    size_t size = 0;
+    int depth = 0;
+    void *frames[MAX_FRAMES] = {};
+};
+
+// capture a call stack every n allocations per thread, 0 turns it off
+void setAllocationSampling(unsigned int every);
+// the most recent samples, at most 256
+std::vector<AllocSample> allocationSamples();
+// function name (demangled) of a code address, or the address
+std::string describeAddress(void *address);
+
+// Counts the allocations of the calling thread in its scope, e.g. to check
+// that a steady-state frame does not allocate.
+class AllocScope {
+public:
+    AllocScope() : start(threadAllocations()) {}
+    AllocCounters counters() const { return threadAllocations() - start; }
+
+private:
+    AllocCounters start;
+};
+
+} // namespace perf
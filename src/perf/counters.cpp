@@ -0,0 +1,128 @@
+#include "counters.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace perf {
+
+Counter::Counter(const char *name, Kind kind)
+    : index(Counters::instance().registerCounter(name, kind)) {
+}
+
+Counters &Counters::instance() {
+    static Counters counters;
+    return counters;
+}
+
+int Counters::registerCounter(const char *name, Counter::Kind kind) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < names.size(); ++i)
+        if (names[i] == name)
+            return (int)i;
+    if (names.size() == MAX_COUNTERS)
+        throw std::runtime_error(std::string("too many counters, cannot add ") + name);
+    names.push_back(name);
+    kinds[names.size() - 1] = kind;
+    numCounters.store((int)names.size(), std::memory_order_release);
+    return (int)names.size() - 1;
+}
+
+std::string Counters::name(int counter) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names[counter];
+}
+
+Counters::Shard &Counters::threadShard() {
+    thread_local Shard *shard = nullptr;
+    if (!shard) {
+        // shards outlive their threads, their counts stay in the totals
+        std::lock_guard<std::mutex> lock(mutex);
+        shards.emplace_back(new Shard());
+        shard = shards.back().get();
+    }
+    return *shard;
+}
+
+void Counters::frameMark(long frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    CounterFrame &f = window[next];
+    f.frame = frame;
+    for (int c = 0; c < (int)names.size(); ++c) {
+        if (kinds[c] == Counter::GAUGE) {
+            f.values[c] = gauges[c].load(std::memory_order_relaxed);
+            continue;
+        }
+        int64_t total = 0;
+        for (const auto &s : shards)
+            total += s->values[c].load(std::memory_order_relaxed);
+        f.values[c] = total - lastTotals[c];
+        lastTotals[c] = total;
+    }
+    next = (next + 1) % WINDOW;
+    size = std::min(size + 1, (int)WINDOW);
+}
+
+bool Counters::latest(CounterFrame &out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0)
+        return false;
+    out = window[(next + WINDOW - 1) % WINDOW];
+    return true;
+}
+
+bool Counters::frame(long index, CounterFrame &out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0)
+        return false;
+    // frames are consecutive unless frameMark() was skipped, so look where
+    // the index should be first
+    const CounterFrame &last = window[(next + WINDOW - 1) % WINDOW];
+    long back = last.frame - index;
+    if (back >= 0 && back < size) {
+        const CounterFrame &f = window[(next + WINDOW - 1 - back) % WINDOW];
+        if (f.frame == index) {
+            out = f;
+            return true;
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        if (window[i].frame == index) {
+            out = window[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+int Counters::history(int counter, float *out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    int start = (size == WINDOW) ? next : 0;
+    for (int i = 0; i < size; ++i)
+        out[i] = (float)window[(start + i) % WINDOW].values[counter];
+    return size;
+}
+
+bool Counters::writeCsv(const std::string &path) const {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fprintf(file, "frame");
+    for (const auto &n : names)
+        std::fprintf(file, ",%s", n.c_str());
+    std::fprintf(file, "\n");
+    int start = (size == WINDOW) ? next : 0;
+    for (int i = 0; i < size; ++i) {
+        const CounterFrame &f = window[(start + i) % WINDOW];
+        std::fprintf(file, "%ld", f.frame);
+        for (size_t c = 0; c < names.size(); ++c)
+            std::fprintf(file, ",%lld", (long long)f.values[c]);
+        std::fprintf(file, "\n");
+    }
+    std::fclose(file);
+    return true;
+}
+
+} // namespace perf
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace perf {
+
+// Workload counters per frame, e.g. particles spawned or draw calls, to
+// correlate frame times with how much work a frame had. A Counter is a
+// handle to a named slot; counters with the same name share the slot.
+//
+// COUNT counters are added to from any thread through a shard of the
+// calling thread (a relaxed load and store, no atomic read-modify-write)
+// and are summed over all shards once per frame. GAUGE counters hold the
+// last value set, e.g. particles alive.
+class Counter {
+public:
+    enum Kind {
+        COUNT,
+        GAUGE
+    };
+
+    explicit Counter(const char *name, Kind kind = COUNT);
+
+    inline void add(int64_t n = 1);
+    inline void set(int64_t value);
+
+    int id() const { return index; }
+
+private:
+    int index;
+};
+
+// Values of all counters in one frame.
+struct CounterFrame {
+    static const int MAX_COUNTERS = 64;
+
+    long frame = -1; // index of the profiler frame
+    int64_t values[MAX_COUNTERS] = {};
+};
+
+class Counters {
+public:
+    static const int MAX_COUNTERS = CounterFrame::MAX_COUNTERS;
+    static const int WINDOW = 600;
+
+    static Counters &instance();
+
+    // index of the counter with that name, registered on first use
+    int registerCounter(const char *name, Counter::Kind kind);
+
+    int count() const { return numCounters.load(std::memory_order_acquire); }
+    std::string name(int counter) const;
+    Counter::Kind kind(int counter) const { return kinds[counter]; }
+
+    // merges the shards into the values of frame, the one that just ended;
+    // call once per frame after Profiler::frameMark()
+    void frameMark(long frame);
+
+    // the latest frame's values; false before the first frameMark()
+    bool latest(CounterFrame &out) const;
+    // the values of a frame if it is still in the window
+    bool frame(long index, CounterFrame &out) const;
+    // values of a counter over the window, oldest first; returns the count
+    int history(int counter, float *out) const;
+
+    // the window as CSV, one row per frame
+    bool writeCsv(const std::string &path) const;
+
+    // for Counter
+    struct alignas(64) Shard {
+        std::atomic<int64_t> values[MAX_COUNTERS];
+    };
+    Shard &threadShard();
+    std::atomic<int64_t> gauges[MAX_COUNTERS] = {};
+
+private:
+    Counters() = default;
+
+    mutable std::mutex mutex;
+    std::vector<std::string> names;
+    Counter::Kind kinds[MAX_COUNTERS] = {};
+    std::atomic<int> numCounters{0};
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    int64_t lastTotals[MAX_COUNTERS] = {};
+    CounterFrame window[WINDOW];
+    int next = 0, size = 0;
+};
+
+inline void Counter::add(int64_t n) {
+    // only this thread writes its shard
+    std::atomic<int64_t> &v = Counters::instance().threadShard().values[index];
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void Counter::set(int64_t value) {
+    Counters::instance().gauges[index].store(value, std::memory_order_relaxed);
+}
+
+} // namespace perf
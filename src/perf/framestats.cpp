@@ -0,0 +1,128 @@
+#include "framestats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace perf {
+
+LogHistogram::LogHistogram(double relativeError, double minValue, double maxValue)
+    : gamma((1 + relativeError) / (1 - relativeError)), logGamma(std::log(gamma)),
+      minValue(minValue), maxValue(maxValue) {
+    counts.assign(bucket(maxValue) + 1, 0);
+}
+
+int LogHistogram::bucket(double v) const {
+    v = std::min(std::max(v, minValue), maxValue);
+    return (int)std::ceil(std::log(v / minValue) / logGamma);
+}
+
+void LogHistogram::add(double v) {
+    counts[bucket(v)]++;
+    total++;
+}
+
+void LogHistogram::remove(double v) {
+    unsigned int &c = counts[bucket(v)];
+    if (c > 0) {
+        c--;
+        total--;
+    }
+}
+
+void LogHistogram::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+}
+
+double LogHistogram::quantile(double q) const {
+    if (total == 0)
+        return 0;
+    long rank = (long)(q * (total - 1));
+    long seen = 0;
+    for (size_t b = 0; b < counts.size(); ++b) {
+        seen += counts[b];
+        if (seen > rank) {
+            // the bucket (minValue * gamma^(b-1), minValue * gamma^b], its
+            // midpoint in relative terms
+            return b == 0 ? minValue : minValue * 2 * std::pow(gamma, (double)b) / (gamma + 1);
+        }
+    }
+    return maxValue;
+}
+
+void decimateMinMax(const float *values, int n, int buckets, float *outMin, float *outMax) {
+    for (int b = 0; b < buckets; ++b) {
+        int begin = (int)((long)b * n / buckets);
+        int end = std::max((int)((long)(b + 1) * n / buckets), begin + 1);
+        end = std::min(end, n);
+        float lo = values[std::min(begin, n - 1)], hi = lo;
+        for (int i = begin; i < end; ++i) {
+            lo = std::min(lo, values[i]);
+            hi = std::max(hi, values[i]);
+        }
+        outMin[b] = lo;
+        outMax[b] = hi;
+    }
+}
+
+const char *FrameStats::channelName(int channel) {
+    static const char *names[NUM_CHANNELS] = {"frame", "process", "draw"};
+    return names[channel];
+}
+
+void FrameStats::frameFinished(float processMs, float drawMs) {
+    Profiler &profiler = Profiler::instance();
+    FrameMarker frame;
+    if (!profiler.lastFrame(frame) || frame.index == lastFrame)
+        return;
+    lastFrame = frame.index;
+
+    float values[NUM_CHANNELS] = {(float)ticksToMs(frame.end - frame.begin), processMs, drawMs};
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+        if (size == WINDOW)
+            histograms[c].remove(samples[c][next]);
+        samples[c][next] = values[c];
+        histograms[c].add(values[c]);
+    }
+    next = (next + 1) % WINDOW;
+    size = std::min(size + 1, (int)WINDOW);
+
+    if (captureSpikes && values[FRAME] > spikeThreshold) {
+        Spike spike;
+        spike.frame = frame;
+        spike.ms = values[FRAME];
+        profiler.collect(frame.begin, frame.end, spike.zones);
+        spike.threadNames = profiler.threadNames();
+        spikeLog.push_back(std::move(spike));
+        if ((int)spikeLog.size() > MAX_SPIKES)
+            spikeLog.pop_front();
+    }
+}
+
+void FrameStats::clear() {
+    next = size = 0;
+    for (auto &h : histograms)
+        h.clear();
+    spikeLog.clear();
+}
+
+Quantiles FrameStats::quantiles(int channel) const {
+    Quantiles q;
+    const LogHistogram &h = histograms[channel];
+    q.p50 = (float)h.quantile(0.5);
+    q.p95 = (float)h.quantile(0.95);
+    q.p99 = (float)h.quantile(0.99);
+    // exact, the window is small
+    for (int i = 0; i < size; ++i)
+        q.max = std::max(q.max, samples[channel][i]);
+    return q;
+}
+
+int FrameStats::history(int channel, float *out) const {
+    int start = (size == WINDOW) ? next : 0;
+    for (int i = 0; i < size; ++i)
+        out[i] = samples[channel][(start + i) % WINDOW];
+    return size;
+}
+
+} // namespace perf
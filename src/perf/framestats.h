@@ -0,0 +1,88 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+namespace perf {
+
+// Quantiles with a bounded relative error: values are counted in buckets of
+// logarithmically growing width (as in DDSketch). Values can be removed
+// again, so it also works over a rolling window.
+class LogHistogram {
+public:
+    // values outside [minValue, maxValue] are clamped
+    explicit LogHistogram(double relativeError = 0.01, double minValue = 1e-3, double maxValue = 1e5);
+
+    void add(double v);
+    void remove(double v);
+    void clear();
+
+    // q in [0, 1]; 0 if empty
+    double quantile(double q) const;
+    long count() const { return total; }
+
+private:
+    int bucket(double v) const;
+
+    double gamma, logGamma, minValue, maxValue;
+    std::vector<unsigned int> counts;
+    long total = 0;
+};
+
+// Downsamples n values to the min and max of each of buckets ranges, so
+// single spikes survive in plots.
+void decimateMinMax(const float *values, int n, int buckets, float *outMin, float *outMax);
+
+struct Quantiles {
+    float p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+// Rolling frame, process and draw times in milliseconds, with quantiles, and
+// the profiler zones of frames that took longer than spikeThreshold.
+class FrameStats {
+public:
+    enum Channel {
+        FRAME,
+        PROCESS,
+        DRAW,
+        NUM_CHANNELS,
+    };
+
+    static const int WINDOW = 600;
+    static const int MAX_SPIKES = 16;
+
+    struct Spike {
+        FrameMarker frame;
+        float ms = 0;
+        std::vector<std::string> threadNames;
+        std::vector<std::vector<ZoneEvent>> zones;
+    };
+
+    float spikeThreshold = 50.f; // ms
+    bool captureSpikes = true;
+
+    static const char *channelName(int channel);
+
+    // call right after Profiler::frameMark(); takes the frame time from the
+    // frame that was just closed
+    void frameFinished(float processMs, float drawMs);
+    void clear();
+
+    Quantiles quantiles(int channel) const;
+    // copies the window of channel, oldest first, and returns its size
+    int history(int channel, float *out) const;
+
+    const std::deque<Spike> &spikes() const { return spikeLog; }
+
+private:
+    float samples[NUM_CHANNELS][WINDOW] = {};
+    int next = 0, size = 0;
+    LogHistogram histograms[NUM_CHANNELS];
+    std::deque<Spike> spikeLog;
+    long lastFrame = -1;
+};
+
+} // namespace perf
@@ -0,0 +1,140 @@
+#include "hwcounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+namespace perf {
+
+const char *hwCounterName(int counter) {
+    static const char *names[NUM_HW_COUNTERS] = {"cycles", "instructions", "cache misses", "branch misses",
+                                                 "page faults"};
+    return names[counter];
+}
+
+#ifdef __linux__
+
+namespace {
+
+// The group is led by the task clock, a software event that always opens,
+// so each hardware counter can fail on its own. Members are read together
+// in one read() and are scheduled onto the PMU as a unit.
+struct CounterGroup {
+    int leader = -1;
+    int fds[NUM_HW_COUNTERS];
+    int slots[NUM_HW_COUNTERS]; // position in the read buffer, -1 if closed
+    uint32_t mask = 0;
+    bool opened = false;
+
+    CounterGroup() {
+        for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+            fds[c] = slots[c] = -1;
+    }
+
+    ~CounterGroup() {
+        for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+            if (fds[c] >= 0)
+                close(fds[c]);
+        if (leader >= 0)
+            close(leader);
+    }
+
+    static int openEvent(uint32_t type, uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.disabled = (groupFd < 0) ? 1 : 0;
+        // this thread on any CPU
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    void open() {
+        opened = true;
+        leader = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1);
+        if (leader < 0)
+            return;
+
+        static const uint32_t types[NUM_HW_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                        PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+        static const uint64_t configs[NUM_HW_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                          PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+                                                          PERF_COUNT_SW_PAGE_FAULTS};
+        int next = 1;
+        for (int c = 0; c < NUM_HW_COUNTERS; ++c) {
+            fds[c] = openEvent(types[c], configs[c], leader);
+            if (fds[c] >= 0) {
+                slots[c] = next++;
+                mask |= 1u << c;
+            }
+        }
+        if (!mask) {
+            close(leader);
+            leader = -1;
+            return;
+        }
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+};
+
+thread_local CounterGroup group;
+
+CounterGroup &threadGroup() {
+    if (!group.opened)
+        group.open();
+    return group;
+}
+
+} // namespace
+
+bool readHwCounters(HwSample &out) {
+    CounterGroup &g = threadGroup();
+    if (g.leader < 0)
+        return false;
+
+    // nr, time enabled, time running, then one value per event
+    uint64_t buffer[3 + 1 + NUM_HW_COUNTERS];
+    if (read(g.leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t)))
+        return false;
+    out.enabled = buffer[1];
+    out.running = buffer[2];
+    for (int c = 0; c < NUM_HW_COUNTERS; ++c)
+        out.values[c] = (g.slots[c] >= 0) ? buffer[3 + g.slots[c]] : 0;
+    return true;
+}
+
+uint32_t hwCounterMask() {
+    return threadGroup().mask;
+}
+
+#else
+
+bool readHwCounters(HwSample &) {
+    return false;
+}
+
+uint32_t hwCounterMask() {
+    return 0;
+}
+
+#endif
+
+void hwCounterDelta(const HwSample &begin, const HwSample &end, uint64_t out[NUM_HW_COUNTERS]) {
+    uint64_t enabled = end.enabled - begin.enabled, running = end.running - begin.running;
+    double scale = (running > 0 && running < enabled) ? (double)enabled / running : 1.0;
+    for (int c = 0; c < NUM_HW_COUNTERS; ++c) {
+        uint64_t d = end.values[c] - begin.values[c];
+        out[c] = (scale == 1.0) ? d : (uint64_t)(d * scale);
+    }
+}
+
+} // namespace perf
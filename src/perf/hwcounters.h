@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace perf {
+
+// Hardware (and a few kernel) event counters of the calling thread, read
+// through a perf_event_open group on Linux. Counters the CPU or the kernel
+// (see /proc/sys/kernel/perf_event_paranoid) do not allow stay zero, e.g.
+// in most virtual machines everything but PAGE_FAULTS.
+enum HwCounter {
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_MISSES, // last level cache
+    BRANCH_MISSES,
+    PAGE_FAULTS,
+    NUM_HW_COUNTERS
+};
+
+const char *hwCounterName(int counter);
+
+// Raw counter values. enabled and running are the nanoseconds the group was
+// enabled and actually counting; they differ when the kernel multiplexes
+// more groups than the PMU has counters.
+struct HwSample {
+    uint64_t values[NUM_HW_COUNTERS] = {};
+    uint64_t enabled = 0, running = 0;
+};
+
+// reads the counters of the calling thread, opening its group on first
+// use; false if no counter could be opened. Costs a read() system call.
+bool readHwCounters(HwSample &out);
+
+// bit c set if counter c could be opened for the calling thread
+uint32_t hwCounterMask();
+
+// counts between two samples, scaled up for the time the group was not
+// scheduled
+void hwCounterDelta(const HwSample &begin, const HwSample &end, uint64_t out[NUM_HW_COUNTERS]);
+
+} // namespace perf
@@ -0,0 +1,142 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace perf {
+
+double ticksPerSecond() {
+#ifdef PERF_HAS_RDTSC
+    static const double rate = []() {
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+        uint64_t c0 = ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t c1 = ticks();
+        double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+        return (c1 - c0) / seconds;
+    }();
+    return rate;
+#else
+    return 1e9;
+#endif
+}
+
+uint64_t ThreadRing::read(uint64_t from, std::vector<ZoneEvent> &out, uint64_t *lost) const {
+    uint64_t n = count();
+    uint64_t first = std::max(from, (n > CAPACITY) ? n - CAPACITY : 0);
+    size_t start = out.size();
+    for (uint64_t i = first; i < n; ++i)
+        out.push_back(events[i & (CAPACITY - 1)]);
+
+    // while we copied, the writer may have overwritten the oldest entries
+    // (including the one it is writing right now)
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now = count();
+    uint64_t valid = (now + 1 > CAPACITY) ? now + 1 - CAPACITY : 0;
+    uint64_t dropped = 0;
+    if (valid > first) {
+        dropped = std::min(valid - first, n - first);
+        out.erase(out.begin() + start, out.begin() + start + dropped);
+    }
+    if (lost)
+        *lost = (first - std::min(from, first)) + dropped;
+    return n;
+}
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+ThreadRing &Profiler::threadRing() {
+    thread_local ThreadRing *ring = nullptr;
+    if (!ring) {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        rings.emplace_back(new ThreadRing());
+        ring = rings.back().get();
+        ring->id = (int)rings.size() - 1;
+        names.push_back((ring->id == 0) ? "main" : "thread " + std::to_string(ring->id));
+    }
+    return *ring;
+}
+
+ThreadRing &Profiler::createRing(const std::string &name) {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    rings.emplace_back(new ThreadRing());
+    ThreadRing &ring = *rings.back();
+    ring.id = (int)rings.size() - 1;
+    names.push_back(name);
+    return ring;
+}
+
+void Profiler::setThreadName(const std::string &name) {
+    ThreadRing &ring = threadRing();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    names[ring.id] = name;
+}
+
+void Profiler::frameMark() {
+    uint64_t now = ticks();
+    if (frameBegin != 0) {
+        long index = frameIndex.load(std::memory_order_relaxed);
+        FrameMarker &f = frameRing[index % FRAMES];
+        f.index = index;
+        f.begin = frameBegin;
+        f.end = now;
+        frameIndex.store(index + 1, std::memory_order_release);
+    }
+    frameBegin = now;
+}
+
+std::vector<FrameMarker> Profiler::frames(int maxFrames) const {
+    // the oldest entry may be overwritten by a concurrent frameMark(), skip it
+    long n = frameCount();
+    long count = std::min<long>({(long)maxFrames, n, (long)FRAMES - 1});
+    std::vector<FrameMarker> result;
+    result.reserve(count);
+    for (long i = n - count; i < n; ++i)
+        result.push_back(frameRing[i % FRAMES]);
+    return result;
+}
+
+bool Profiler::lastFrame(FrameMarker &out) const {
+    long n = frameCount();
+    if (n == 0)
+        return false;
+    out = frameRing[(n - 1) % FRAMES];
+    return true;
+}
+
+std::vector<ThreadRing *> Profiler::threads() const {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    std::vector<ThreadRing *> result;
+    for (const auto &r : rings)
+        result.push_back(r.get());
+    return result;
+}
+
+std::vector<std::string> Profiler::threadNames() const {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    return names;
+}
+
+void Profiler::collect(uint64_t begin, uint64_t end, std::vector<std::vector<ZoneEvent>> &out) const {
+    std::vector<ThreadRing *> all = threads();
+    out.resize(all.size());
+    std::vector<ZoneEvent> events;
+    for (size_t t = 0; t < all.size(); ++t) {
+        out[t].clear();
+        events.clear();
+        all[t]->read(0, events);
+        // zones are pushed as they end, so the ring is sorted by end time
+        auto first = std::lower_bound(events.begin(), events.end(), begin,
+                                      [](const ZoneEvent &e, uint64_t t) { return e.end <= t; });
+        for (auto it = first; it != events.end(); ++it)
+            if (it->begin < end)
+                out[t].push_back(*it);
+    }
+}
+
+} // namespace perf
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "alloctracker.h"
+#include "hwcounters.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#define PERF_HAS_RDTSC
+#else
+#include <chrono>
+#endif
+
+namespace perf {
+
+// a cheap monotonic timestamp: the time stamp counter where there is one,
+// otherwise nanoseconds
+inline uint64_t ticks() {
+#ifdef PERF_HAS_RDTSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// measured once, on first use
+double ticksPerSecond();
+
+inline double ticksToMs(uint64_t ticks) { return ticks * 1e3 / ticksPerSecond(); }
+
+// A finished zone. name must outlive the profiler, e.g. a string literal.
+struct ZoneEvent {
+    const char *name = nullptr;
+    uint64_t begin = 0, end = 0;
+    uint16_t depth = 0; // nesting level on its thread
+    // heap allocations in the zone, with CMM_TRACK_ALLOCATIONS
+    uint32_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    // hardware counter deltas, while Profiler::hwCounters is set
+    uint64_t counters[NUM_HW_COUNTERS] = {};
+};
+
+// Zones recorded by one thread. Only that thread writes; readers copy what
+// they need and check it was not overwritten meanwhile (see read()). The
+// name lives in the Profiler, which can rename the thread at any time.
+class ThreadRing {
+public:
+    static const uint64_t CAPACITY = 1 << 14;
+
+    int id = 0;
+
+    void push(const ZoneEvent &e) {
+        uint64_t n = written.load(std::memory_order_relaxed);
+        events[n & (CAPACITY - 1)] = e;
+        written.store(n + 1, std::memory_order_release);
+    }
+
+    // number of zones ever pushed
+    uint64_t count() const { return written.load(std::memory_order_acquire); }
+
+    // copies zones [from, count()) that are still in the ring to out and
+    // returns where the next read should start; sets lost to the number of
+    // requested zones that were already overwritten
+    uint64_t read(uint64_t from, std::vector<ZoneEvent> &out, uint64_t *lost = nullptr) const;
+
+    // current nesting level, only touched by the owning thread
+    uint16_t depth = 0;
+
+private:
+    ZoneEvent events[CAPACITY];
+    std::atomic<uint64_t> written{0};
+};
+
+// The boundary between two frames of the render loop.
+struct FrameMarker {
+    long index = 0;
+    uint64_t begin = 0, end = 0;
+};
+
+// Collects zones of all threads into per-thread rings and frame markers
+// into a ring of its own. Recording is wait-free; nothing allocates after
+// a thread's first zone.
+class Profiler {
+public:
+    static const int FRAMES = 256;
+
+    static Profiler &instance();
+
+    // while false, zones cost one load and a branch
+    std::atomic<bool> enabled{true};
+    // sample hardware counters (see hwcounters.h) at zone boundaries; adds
+    // two system calls per zone
+    std::atomic<bool> hwCounters{false};
+
+    // the ring of the calling thread, created on first use
+    ThreadRing &threadRing();
+    void setThreadName(const std::string &name);
+    // a lane that is not a thread, e.g. the GPU; only one thread may push
+    // to it
+    ThreadRing &createRing(const std::string &name);
+
+    // closes the current frame and starts the next one; call once per
+    // iteration of the render loop
+    void frameMark();
+
+    // the last completed frames, oldest first
+    std::vector<FrameMarker> frames(int maxFrames = FRAMES) const;
+    // the last completed frame without allocating; false before the first
+    bool lastFrame(FrameMarker &out) const;
+    long frameCount() const { return frameIndex.load(std::memory_order_acquire); }
+
+    // all rings, also of threads that have ended
+    std::vector<ThreadRing *> threads() const;
+    // names of the rings; names[i] belongs to threads()[i] of an earlier
+    // call (rings are only ever added), so call it after threads() or
+    // collect()
+    std::vector<std::string> threadNames() const;
+
+    // zones of every thread that overlap [begin, end); out[i] belongs to
+    // threads()[i]
+    void collect(uint64_t begin, uint64_t end, std::vector<std::vector<ZoneEvent>> &out) const;
+
+private:
+    Profiler() = default;
+
+    // guards both; names[i] is the name of rings[i]
+    mutable std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::vector<std::string> names;
+
+    FrameMarker frameRing[FRAMES];
+    std::atomic<long> frameIndex{0};
+    uint64_t frameBegin = 0;
+};
+
+// Times the enclosing scope, see PROFILE_ZONE.
+class Zone {
+public:
+    explicit Zone(const char *name) {
+        if (!Profiler::instance().enabled.load(std::memory_order_relaxed))
+            return;
+        ring = &Profiler::instance().threadRing();
+        event.name = name;
+        event.depth = ring->depth++;
+#ifdef CMM_TRACK_ALLOCATIONS
+        allocs = threadAllocations();
+#endif
+        // counters are read outside of the timed span, so they only add
+        // to the wall time of enclosing zones
+        if (Profiler::instance().hwCounters.load(std::memory_order_relaxed))
+            counting = readHwCounters(counters);
+        event.begin = ticks();
+    }
+
+    ~Zone() {
+        if (!ring)
+            return;
+        event.end = ticks();
+        HwSample end;
+        if (counting && readHwCounters(end))
+            hwCounterDelta(counters, end, event.counters);
+#ifdef CMM_TRACK_ALLOCATIONS
+        AllocCounters a = threadAllocations() - allocs;
+        event.allocations = (uint32_t)a.allocations;
+        event.allocatedBytes = a.bytes;
+#endif
+        ring->depth--;
+        ring->push(event);
+    }
+
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+private:
+    ThreadRing *ring = nullptr;
+    ZoneEvent event;
+    bool counting = false;
+    HwSample counters;
+#ifdef CMM_TRACK_ALLOCATIONS
+    AllocCounters allocs;
+#endif
+};
+
+inline void setThreadName(const std::string &name) {
+    Profiler::instance().setThreadName(name);
+}
+
+} // namespace perf
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+
+// times the rest of the scope under name (a string literal)
+#define PROFILE_ZONE(name) perf::Zone PERF_CONCAT(perfZone, __LINE__)(name)
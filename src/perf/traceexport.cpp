@@ -0,0 +1,157 @@
+#include "traceexport.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <chrono>
+
+#include "counters.h"
+
+namespace perf {
+
+namespace {
+
+// zone and thread names end up in JSON strings
+std::string escape(const char *s) {
+    std::string out;
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\')
+            out += '\\';
+        if ((unsigned char)*s >= 0x20)
+            out += *s;
+    }
+    return out;
+}
+
+// hardware counters of a zone as trace args, if it has any
+std::string counterArgs(const ZoneEvent &e) {
+    std::string args;
+    for (int c = 0; c < NUM_HW_COUNTERS; ++c) {
+        if (e.counters[c] == 0)
+            continue;
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%llu", args.empty() ? "" : ",", hwCounterName(c),
+                 (unsigned long long)e.counters[c]);
+        args += buffer;
+    }
+    return args.empty() ? args : ",\"args\":{" + args + "}";
+}
+
+} // namespace
+
+TraceWriter::TraceWriter(const std::string &path, int intervalMs)
+    : intervalMs(intervalMs), startTicks(ticks()) {
+    file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return;
+    fileBuffer.resize(1 << 20);
+    std::setvbuf(file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+    std::fputs("[\n", file);
+
+    // only frames and zones from now on
+    Profiler &profiler = Profiler::instance();
+    nextFrame = profiler.frameCount();
+    for (ThreadRing *ring : profiler.threads())
+        cursors.push_back(ring->count());
+
+    thread = std::thread([this]() { loop(); });
+}
+
+TraceWriter::~TraceWriter() {
+    if (!file)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    thread.join();
+
+    flush();
+    writeEvent("{\"name\":\"dropped zones\",\"ph\":\"M\",\"pid\":1,\"args\":{\"count\":%llu}}",
+               (unsigned long long)dropped.load());
+    writeEvent("{\"name\":\"dropped frames\",\"ph\":\"M\",\"pid\":1,\"args\":{\"count\":%llu}}",
+               (unsigned long long)droppedFrameCount.load());
+    std::fputs("\n]\n", file);
+    std::fclose(file);
+}
+
+void TraceWriter::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!quit) {
+        wake.wait_for(lock, std::chrono::milliseconds(intervalMs));
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+void TraceWriter::writeEvent(const char *fmt, ...) {
+    std::fputs(first ? "" : ",\n", file);
+    first = false;
+    va_list args;
+    va_start(args, fmt);
+    std::vfprintf(file, fmt, args);
+    va_end(args);
+    written++;
+}
+
+void TraceWriter::flush() {
+    Profiler &profiler = Profiler::instance();
+
+    std::vector<ThreadRing *> rings = profiler.threads();
+    std::vector<std::string> current = profiler.threadNames();
+    cursors.resize(rings.size(), 0);
+    for (size_t t = 0; t < rings.size(); ++t) {
+        // announce threads by name, again if they were renamed
+        if (t >= names.size() || names[t] != current[t]) {
+            names.resize(std::max(names.size(), t + 1));
+            names[t] = current[t];
+            writeEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                       rings[t]->id, escape(names[t].c_str()).c_str());
+        }
+
+        events.clear();
+        uint64_t lost = 0;
+        cursors[t] = rings[t]->read(cursors[t], events, &lost);
+        dropped += lost;
+        for (const auto &e : events) {
+            if (e.begin < startTicks)
+                continue;
+            writeEvent("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d%s}",
+                       escape(e.name).c_str(), micros(e.begin), micros(e.end) - micros(e.begin), rings[t]->id,
+                       counterArgs(e).c_str());
+        }
+    }
+
+    // frames as instant markers plus a frame time counter and the workload
+    // counters; a frame whose counters are not merged yet waits for the
+    // next flush
+    long count = profiler.frameCount();
+    Counters &counters = Counters::instance();
+    CounterFrame values;
+    if (counters.latest(values))
+        count = std::min(count, values.frame + 1);
+    // the whole ring: asking for the last count - nextFrame frames would
+    // miss the oldest ones whenever frames past count were marked already
+    std::vector<FrameMarker> frames = profiler.frames();
+    long oldest = frames.empty() ? count : frames.front().index;
+    if (oldest > nextFrame)
+        droppedFrameCount += std::min(oldest, count) - nextFrame;
+    for (const auto &f : frames) {
+        if (f.index < nextFrame || f.index >= count || f.begin < startTicks)
+            continue;
+        writeEvent("{\"name\":\"frame %ld\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                   f.index, micros(f.begin));
+        writeEvent("{\"name\":\"frame time\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"ms\":%.3f}}",
+                   micros(f.begin), ticksToMs(f.end - f.begin));
+        if (!counters.frame(f.index, values))
+            continue;
+        for (int c = 0; c < counters.count(); ++c)
+            writeEvent("{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%lld}}",
+                       escape(counters.name(c).c_str()).c_str(), micros(f.begin), (long long)values.values[c]);
+    }
+    nextFrame = std::max(nextFrame, count);
+    std::fflush(file);
+}
+
+} // namespace perf
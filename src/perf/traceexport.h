@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "profiler.h"
+
+namespace perf {
+
+// Streams profiler zones, frame markers and frame times to a Chrome trace
+// event file (JSON array format), which chrome://tracing and Perfetto open.
+// A background thread wakes up every interval, copies what was recorded
+// since its last visit from the rings with a cursor of its own and appends
+// it, so memory stays bounded however long the run. Zones and frames
+// overwritten before the writer got to them are counted in droppedZones()
+// and droppedFrames(), and written to the end of the file.
+class TraceWriter {
+public:
+    // starts writing to path right away; check isOpen()
+    explicit TraceWriter(const std::string &path, int intervalMs = 10);
+    // writes what is left and closes the file
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+    uint64_t droppedZones() const { return dropped; }
+    uint64_t droppedFrames() const { return droppedFrameCount; }
+    uint64_t writtenEvents() const { return written; }
+
+private:
+    void loop();
+    void flush();
+    void writeEvent(const char *fmt, ...);
+
+    double micros(uint64_t t) const { return (double)(t - startTicks) * 1e6 / ticksPerSecond(); }
+
+    std::FILE *file = nullptr;
+    std::vector<char> fileBuffer;
+    const int intervalMs;
+    const uint64_t startTicks;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+
+    // only touched by the writer thread
+    std::vector<uint64_t> cursors;
+    std::vector<std::string> names;
+    std::vector<ZoneEvent> events;
+    long nextFrame = 0;
+    bool first = true;
+    std::atomic<uint64_t> dropped{0}, droppedFrameCount{0}, written{0};
+};
+
+} // namespace perf
@@ -0,0 +1,211 @@
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pbd.h>
+
+using nlohmann::json;
+using namespace math;
+
+// Runs a PBD scene for every combination of the swept parameters and writes
+// one JSON line of metrics per run to the results file, in the order the
+// runs finish. A spec looks like
+//
+//   {
+//     "scene": "rope",              // rope, softbody or particles
+//     "steps": 600, "dt": 0.0166667,
+//     "threads": 0,                 // 0: all cores
+//     "parameters": {"substeps": 8},
+//     "sweep": {"substeps": [2, 4, 8, 16], "compliance": [0, 1e-6, 1e-4]}
+//   }
+//
+// with fixed values in "parameters" and lists in "sweep"; see PARAMETERS for
+// what can be set. Every worker owns its solver, the only shared state is
+// the index of the next run and the results file.
+
+namespace {
+
+const std::set<std::string> PARAMETERS = {
+    // solver
+    "substeps", "iterations", "damping", "gravity", "collisions", "collisionCompliance",
+    // scenes
+    "count", "radius", "compliance", "bendingCompliance", "length", "cols", "rows", "spacing",
+};
+
+const float WIDTH = 800.f, HEIGHT = 600.f;
+
+float param(const json &p, const char *name, float def) {
+    auto it = p.find(name);
+    return (it == p.end()) ? def : it->get<float>();
+}
+
+void setupScene(const std::string &scene, const json &p, PBDSolver &pbd) {
+    pbd.substeps = (int)param(p, "substeps", (float)pbd.substeps);
+    pbd.iterations = (int)param(p, "iterations", (float)pbd.iterations);
+    pbd.damping = param(p, "damping", pbd.damping);
+    pbd.gravity = Vector2f(0.f, param(p, "gravity", pbd.gravity[1]));
+    pbd.collisions = param(p, "collisions", 1.f) != 0.f;
+    pbd.collisionCompliance = param(p, "collisionCompliance", pbd.collisionCompliance);
+    pbd.setBounds(Vector2f(0, 0), Vector2f(WIDTH, HEIGHT));
+
+    float radius = param(p, "radius", 8.f);
+    if (!(radius > 0.f))
+        throw std::runtime_error("radius must be positive");
+    if (scene == "rope") {
+        float length = param(p, "length", 600.f);
+        pbd.addRope(Vector2f(100, 50), Vector2f(100 + length, 50), (int)param(p, "count", 40.f), radius,
+                    param(p, "compliance", 0.f), param(p, "bendingCompliance", 1e-2f));
+    } else if (scene == "softbody") {
+        pbd.addSoftBody(Vector2f(200, 50), (int)param(p, "cols", 10.f), (int)param(p, "rows", 6.f),
+                        param(p, "spacing", 20.f), radius, param(p, "compliance", 1e-5f));
+    } else if (scene == "particles") {
+        pbd.addParticleRows(Vector2f(0, 0), WIDTH, (int)param(p, "count", 200.f), radius);
+    } else {
+        throw std::runtime_error("unknown scene '" + scene + "'");
+    }
+}
+
+json runOnce(const std::string &scene, const json &p, int steps, float dt) {
+    using clock = std::chrono::steady_clock;
+
+    PBDSolver pbd(1);
+    setupScene(scene, p, pbd);
+
+    float peakError = 0.f;
+    int peakContacts = 0;
+    const auto start = clock::now();
+    for (int s = 0; s < steps; ++s) {
+        pbd.step(dt);
+        peakError = std::max(peakError, pbd.maxDistanceError());
+        peakContacts = std::max(peakContacts, pbd.numContacts());
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    double energy = 0;
+    bool finite = true;
+    for (const auto &q : pbd.particles) {
+        if (!q.pos.allFinite() || !q.vel.allFinite())
+            finite = false;
+        else if (q.invMass > 0.f)
+            energy += 0.5 * q.vel.squaredNorm() / q.invMass;
+    }
+
+    json m;
+    m["seconds"] = seconds;
+    m["stepsPerSecond"] = steps / std::max(seconds, 1e-9);
+    m["particles"] = pbd.particles.size();
+    m["constraints"] = pbd.numConstraints();
+    m["colors"] = pbd.numColors();
+    m["peakContacts"] = peakContacts;
+    m["peakDistanceError"] = peakError;
+    m["finalDistanceError"] = pbd.maxDistanceError();
+    m["kineticEnergy"] = energy;
+    m["finite"] = finite;
+    return m;
+}
+
+void checkParameters(const json &p) {
+    for (auto it = p.begin(); it != p.end(); ++it)
+        if (!PARAMETERS.count(it.key()))
+            throw std::runtime_error("unknown parameter '" + it.key() + "'");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cout << "usage: sweep spec.json results.jsonl" << std::endl;
+        return 1;
+    }
+
+    std::string scene;
+    int steps, numThreads;
+    float dt;
+    json base, sweep;
+    try {
+        std::ifstream file(argv[1]);
+        if (!file)
+            throw std::runtime_error(std::string("cannot read ") + argv[1]);
+        json spec = json::parse(file);
+        scene = spec.value("scene", std::string("rope"));
+        steps = spec.value("steps", 600);
+        dt = spec.value("dt", 1.f / 60.f);
+        numThreads = spec.value("threads", 0);
+        base = spec.value("parameters", json::object());
+        sweep = spec.value("sweep", json::object());
+        checkParameters(base);
+        checkParameters(sweep);
+        for (auto it = sweep.begin(); it != sweep.end(); ++it)
+            if (!it->is_array() || it->empty())
+                throw std::runtime_error("sweep values of '" + it.key() + "' must be a non-empty list");
+    } catch (const std::exception &e) {
+        std::cout << "invalid sweep spec: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream results(argv[2]);
+    if (!results) {
+        std::cout << "cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    // cartesian product, run i picks its values by the digits of i in the
+    // mixed radix of the list sizes
+    int numRuns = 1;
+    for (auto it = sweep.begin(); it != sweep.end(); ++it)
+        numRuns *= (int)it->size();
+
+    if (numThreads <= 0)
+        numThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, numRuns);
+    std::cout << "sweep: " << numRuns << " runs of '" << scene << "' on " << numThreads << " threads" << std::endl;
+
+    std::atomic<int> nextRun{0};
+    std::mutex resultsMutex;
+    int finished = 0;
+
+    auto worker = [&]() {
+        for (int run = nextRun++; run < numRuns; run = nextRun++) {
+            json p = base;
+            int digits = run;
+            for (auto it = sweep.begin(); it != sweep.end(); ++it) {
+                p[it.key()] = (*it)[digits % it->size()];
+                digits /= (int)it->size();
+            }
+
+            json line;
+            line["run"] = run;
+            line["parameters"] = p;
+            try {
+                line["metrics"] = runOnce(scene, p, steps, dt);
+            } catch (const std::exception &e) {
+                line["error"] = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results << line.dump() << "\n";
+            results.flush();
+            std::cout << "[" << ++finished << "/" << numRuns << "] run " << run << std::endl;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+        t.join();
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+
+#include <pbd.h>
+
+#include <cmath>
+#include <set>
+
+// Checks the XPBD solver: the constraint coloring it projects in parallel
+// and that constraints converge to their rest state.
+
+bool check(bool ok, const char *what) {
+    std::cout << (ok ? "passed: " : "FAILED: ") << what << std::endl;
+    return ok;
+}
+
+bool testColoring() {
+    math::PBDSolver pbd(1);
+    pbd.addRope({0, 0}, {400, 0}, 30, 5.f);
+    pbd.addSoftBody({0, 100}, 10, 6, 20.f, 8.f);
+    std::vector<math::Constraint> constraints;
+    auto add = [&](int i, int j, int k = -1) {
+        math::Constraint c;
+        c.type = (k < 0) ? math::Constraint::DISTANCE : math::Constraint::BENDING;
+        c.p[0] = i;
+        c.p[1] = j;
+        c.p[2] = k;
+        constraints.push_back(c);
+    };
+    int n = (int)pbd.particles.size();
+    for (int i = 0; i + 2 < n; ++i)
+        add(i, i + 1, i + 2);
+    for (int i = 0; i < n; ++i)
+        add(i, (i + n / 2) % n);
+    // more constraints on one particle than there are colors
+    for (int i = 1; i < 80; ++i)
+        add(0, i);
+
+    math::ConstraintBatches batches;
+    math::colorConstraints(constraints, n, batches);
+    bool passed = check(batches.offsets.back() == (int)constraints.size(), "batches hold every constraint");
+    passed &= check(batches.serialLast, "constraints without a color go into a serial batch");
+
+    bool disjoint = true;
+    int parallelBatches = batches.numBatches() - (batches.serialLast ? 1 : 0);
+    for (int b = 0; b < parallelBatches; ++b) {
+        std::set<int> particles;
+        for (int c = batches.offsets[b]; c < batches.offsets[b + 1]; ++c) {
+            const math::Constraint &con = batches.constraints[c];
+            for (int k = 0; k < con.numParticles(); ++k)
+                disjoint &= particles.insert(con.p[k]).second;
+        }
+    }
+    passed &= check(disjoint, "constraints of a batch share no particle");
+    return passed;
+}
+
+bool testDistance() {
+    math::PBDSolver pbd(1);
+    pbd.gravity = {0, 0};
+    pbd.collisions = false;
+    int a = pbd.addParticle({0, 0}, 1.f, 0.f);
+    int b = pbd.addParticle({10, 0}, 1.f);
+    pbd.addDistanceConstraint(a, b);
+
+    // stretch it to twice its rest length and let it settle
+    pbd.particles[b].pos = pbd.particles[b].prevPos = {20, 0};
+    for (int i = 0; i < 60; ++i)
+        pbd.step(1.f / 60.f);
+    float length = (pbd.particles[b].pos - pbd.particles[a].pos).norm();
+    bool passed = check(std::abs(length - 10.f) < 1e-3f, "a rigid distance constraint returns to its rest length");
+    passed &= check(pbd.particles[a].pos == math::Vector2f(0, 0), "pinned particles do not move");
+
+    // a chain under gravity keeps its length with enough substeps
+    math::PBDSolver chain(2);
+    chain.collisions = false;
+    chain.addRope({0, 0}, {200, 0}, 20, 2.f);
+    for (int i = 0; i < 120; ++i)
+        chain.step(1.f / 60.f);
+    passed &= check(chain.maxDistanceError() < 0.5f, "a hanging rope keeps its length");
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    bool passed = testColoring();
+    passed &= testDistance();
+    return passed ? 0 : 1;
+}
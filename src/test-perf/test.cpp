@@ -0,0 +1,131 @@
+#include <iostream>
+
+#include <alloctracker.h>
+#include <counters.h>
+#include <framestats.h>
+#include <hwcounters.h>
+#include <pbd.h>
+#include <profiler.h>
+
+#include <thread>
+
+// Checks the profiler's optional probes where this machine and build have
+// them: hardware counters per zone and, in a CMM_TRACK_ALLOCATIONS build,
+// that steady-state frames do not touch the heap.
+
+bool check(bool ok, const char *what) {
+    std::cout << (ok ? "passed: " : "FAILED: ") << what << std::endl;
+    return ok;
+}
+
+perf::Counter steps("test/steps");
+
+// a frame of a PBD scene with the profiling the application does
+void frame(math::PBDSolver &pbd, perf::FrameStats &stats) {
+    perf::Profiler::instance().frameMark();
+    perf::Counters::instance().frameMark(perf::Profiler::instance().frameCount() - 1);
+    stats.frameFinished(0.f, 0.f);
+    PROFILE_ZONE("frame");
+    pbd.step(1.f / 60.f);
+    steps.add();
+}
+
+bool testCounters() {
+    perf::Counter count("test/count");
+    perf::Counter gauge("test/gauge", perf::Counter::GAUGE);
+    perf::Counters &counters = perf::Counters::instance();
+    bool passed = check(perf::Counter("test/count").id() == count.id(), "counters with the same name share a slot");
+
+    // shards of all threads are summed, also of threads that have ended
+    counters.frameMark(100);
+    std::thread worker([&]() {
+        for (int i = 0; i < 1000; ++i)
+            count.add();
+    });
+    count.add(10);
+    worker.join();
+    gauge.set(7);
+    counters.frameMark(101);
+    count.add(5);
+    counters.frameMark(102);
+
+    perf::CounterFrame f101, f102;
+    passed &= check(counters.frame(101, f101) && f101.values[count.id()] == 1010, "counts are merged per frame");
+    passed &= check(counters.frame(102, f102) && f102.values[count.id()] == 5, "counts restart every frame");
+    passed &= check(f102.values[gauge.id()] == 7, "gauges keep their value");
+    return passed;
+}
+
+bool testHwCounters() {
+    if (!perf::hwCounterMask()) {
+        std::cout << "skipped: no hardware counters" << std::endl;
+        return true;
+    }
+
+    // first touch of fresh pages faults, and everything takes instructions
+    const size_t size = 16 << 20;
+    char *buffer = new char[size];
+    perf::Profiler::instance().hwCounters = true;
+    {
+        PROFILE_ZONE("touch");
+        for (size_t i = 0; i < size; i += 4096)
+            buffer[i] = (char)i;
+    }
+    perf::Profiler::instance().hwCounters = false;
+    delete[] buffer;
+
+    std::vector<perf::ZoneEvent> zones;
+    perf::Profiler::instance().threadRing().read(0, zones);
+    const perf::ZoneEvent &touch = zones.back();
+    uint32_t mask = perf::hwCounterMask();
+    bool passed = true;
+    if (mask & (1u << perf::PAGE_FAULTS))
+        passed &= check(touch.counters[perf::PAGE_FAULTS] >= size / 4096 / 2, "zones count page faults");
+    if (mask & (1u << perf::INSTRUCTIONS))
+        passed &= check(touch.counters[perf::INSTRUCTIONS] >= size / 4096, "zones count instructions");
+    return passed;
+}
+
+bool testAllocations() {
+    if (!perf::allocationTracking()) {
+        std::cout << "skipped: allocations are counted by test-perf-alloc" << std::endl;
+        return true;
+    }
+
+    bool passed = true;
+    {
+        perf::AllocScope scope;
+        // a new/delete expression pair may be elided, the functions may not
+        ::operator delete(::operator new(sizeof(int)));
+        passed &= check(scope.counters().allocations == 1 && scope.counters().frees == 1, "new and delete are counted");
+    }
+
+    math::PBDSolver pbd(1);
+    pbd.setBounds({0, 0}, {800, 600});
+    pbd.addRope({100, 50}, {500, 50}, 40, 5.f);
+    pbd.addSoftBody({300, 200}, 8, 5, 20.f, 8.f);
+    for (int i = 0; i < 100; ++i)
+        pbd.addParticle({40.f + (i % 25) * 24, 400.f + (i / 25) * 24}, 10.f);
+    perf::FrameStats stats;
+    stats.captureSpikes = false;
+
+    // buffers grow to their steady-state size
+    for (int i = 0; i < 120; ++i)
+        frame(pbd, stats);
+
+    perf::AllocScope scope;
+    for (int i = 0; i < 120; ++i)
+        frame(pbd, stats);
+    perf::AllocCounters a = scope.counters();
+    std::cout << a.allocations << " allocations, " << a.bytes << " bytes in 120 frames" << std::endl;
+    passed &= check(a.allocations == 0, "steady-state frames do not allocate");
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    bool passed = testCounters();
+    passed &= testHwCounters();
+    passed &= testAllocations();
+    return passed ? 0 : 1;
+}